@@ -0,0 +1,94 @@
+'''
+toaster_sprites.py
+
+    The flying toasters using Sprite objects. The bitmaps are expanded once
+    when the sprites are created and sprites() only sends the area each
+    toaster left and moved to, drawn over the background with black as the
+    transparent color.
+
+    spritesheet from CircuitPython_Flying_Toasters
+    https://learn.adafruit.com/circuitpython-sprite-animation-pendant-mario-clouds-flying-toasters
+'''
+
+import time
+import random
+from machine import Pin, SPI
+import ili9342c
+import t1,t2,t3,t4,t5
+
+TOASTERS = [t1, t2, t3, t4]
+TOAST = [t5]
+BACKGROUND = ili9342c.color565(0, 0, 64)
+
+
+class toast():
+    '''
+    toast class to keep track of a sprite's location and speed
+    '''
+    def __init__(self, frames, x, y):
+        self.sprite = ili9342c.Sprite(frames, x, y, key=ili9342c.BLACK)
+        self.sprite.frame(random.randint(0, len(frames)-1))
+        self.x = x
+        self.y = y
+        self.speed = random.randint(2, 5)
+
+    def move(self):
+        if self.x <= -64:
+            self.speed = random.randint(2, 5)
+            self.x = 320
+
+        self.x -= self.speed
+        self.sprite.move(self.x, self.y)
+        self.sprite.frame(self.sprite.frame() + 1)
+
+
+def main():
+    '''
+    Draw and move sprites
+    '''
+    try:
+
+        spi = SPI(2, baudrate=60000000, sck=Pin(18), mosi=Pin(23))
+
+        # initialize display
+
+        tft = ili9342c.ILI9342C(
+            spi,
+            320,
+            240,
+            reset=Pin(33, Pin.OUT),
+            cs=Pin(14, Pin.OUT),
+            dc=Pin(27, Pin.OUT),
+            backlight=Pin(32, Pin.OUT),
+            rotation=0,
+            buffer_size=320*16*2)
+
+        # enable display and clear screen
+        tft.init()
+        tft.fill(BACKGROUND)
+
+        # create toast sprites in random positions
+        toasts = [
+            toast(TOASTERS, 320-64, 0),
+            toast(TOAST, 320-64*2, 80),
+            toast(TOASTERS, 320-64*4, 160),
+            toast(TOASTERS, 320-64*3, 40),
+            toast(TOAST, 320-64, 120)]
+
+        sprites = [man.sprite for man in toasts]
+
+        # move and draw sprites
+        while True:
+            for man in toasts:
+                man.move()
+
+            tft.sprites(sprites, BACKGROUND)
+            time.sleep(0.03)
+
+    finally:
+        # shutdown spi
+        if 'spi' in locals():
+            spi.deinit()
+
+
+main()
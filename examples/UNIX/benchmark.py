@@ -0,0 +1,165 @@
+'''
+benchmark.py
+
+    Drive every drawing method with a fixed workload against the recording
+    MockSPI bus and report what would have gone over the wire. Requires the
+    unix port built with the driver and the mock bus:
+
+        $ cd micropython/ports/unix
+        $ make USER_C_MODULES=../../../ili9342c_mpy/src/micropython.cmake \
+            ILI9342C_MOCK_SPI=1
+
+    Run it from the top of the ili9342c_mpy directory so the fonts, bitmaps
+    and jpg used by the workloads can be found:
+
+        $ ../micropython/ports/unix/build-standard/micropython \
+            examples/UNIX/benchmark.py
+
+    bigbuckbunny.jpg (c) copyright 2008, Blender Foundation / www.bigbuckbunny.org
+'''
+
+import sys
+import math
+import time
+import ili9342c
+
+sys.path.append('modules')
+sys.path.append('examples/M5STACK/prop_fonts')
+sys.path.append('examples/M5STACK/toasters')
+
+import vga1_8x16 as font
+import chango_16 as prop_font
+import romans as vector_font
+import t1 as bitmap
+
+JPG = 'examples/M5STACK/bbbunny/bigbuckbunny.jpg'
+
+COLUMNS = (
+    'bytes', 'transfers', 'cs_toggles', 'dc_toggles',
+    'caset', 'paset', 'ramwr')
+
+
+def fill_rect(tft):
+    for i in range(20):
+        tft.fill_rect(i * 8, i * 6, 160, 120, ili9342c.color565(i * 12, 0, 255))
+
+
+def line(tft):
+    for i in range(0, 320, 8):
+        tft.line(i, 0, 319 - i, 239, ili9342c.WHITE)
+    for i in range(0, 240, 8):
+        tft.line(0, i, 319, 239 - i, ili9342c.RED)
+
+
+def line_aa(tft):
+    for i in range(0, 320, 8):
+        tft.line(i, 0, 319 - i, 239, ili9342c.WHITE, ili9342c.BLACK)
+    for i in range(0, 240, 8):
+        tft.line(0, i, 319, 239 - i, ili9342c.RED, ili9342c.BLACK)
+
+
+def gauge(tft):
+    tft.fill_round_rect(40, 10, 240, 220, 16, ili9342c.color565(32, 32, 48))
+    tft.fill_circle(160, 120, 100, ili9342c.BLACK)
+    tft.circle(160, 120, 100, ili9342c.WHITE)
+    tft.ellipse(160, 170, 40, 14, ili9342c.CYAN)
+    for i in range(11):
+        angle = math.radians(135 + i * 27)
+        tft.fill_circle(160 + int(88 * math.cos(angle)), 120 + int(88 * math.sin(angle)), 3, ili9342c.WHITE)
+    for value in range(0, 100, 10):
+        angle = math.radians(135 + value * 2.7)
+        x, y = int(80 * math.cos(angle)), int(80 * math.sin(angle))
+        tft.fill_triangle(160 + x, 120 + y, 160 - y // 10, 120 + x // 10, 160 + y // 10, 120 - x // 10, ili9342c.RED)
+    tft.fill_polygon([0, -12, 12, 0, 0, 12, -12, 0], 160, 120, ili9342c.YELLOW)
+
+
+def text(tft):
+    for row in range(15):
+        tft.text(font, 'The quick brown fox jumps over', 0, row * 16)
+
+
+def write(tft):
+    for row in range(14):
+        tft.write(prop_font, 'The quick brown fox jumps', 0, row * 17)
+
+
+def bitmap_(tft):
+    for i in range(16):
+        tft.bitmap(bitmap, (i % 5) * 64, (i // 5) * 64)
+
+
+def draw(tft):
+    for row in range(6):
+        tft.draw(vector_font, 'Hello Hershey', 0, 32 + row * 36, ili9342c.GREEN)
+
+
+def draw_aa(tft):
+    for row in range(6):
+        tft.draw(vector_font, 'Hello Hershey', 0, 32 + row * 36, ili9342c.GREEN, 1, ili9342c.BLACK)
+
+
+def jpg_fast(tft):
+    tft.jpg(JPG, 0, 0, ili9342c.FAST)
+
+
+def jpg_slow(tft):
+    tft.jpg(JPG, 0, 0, ili9342c.SLOW)
+
+
+def jpg_bytes(tft):
+    with open(JPG, 'rb') as f:
+        data = f.read()
+    tft.jpg(data, 0, 0, ili9342c.FAST)
+
+
+WORKLOADS = (
+    ('fill_rect', fill_rect),
+    ('line', line),
+    ('line aa', line_aa),
+    ('gauge', gauge),
+    ('text', text),
+    ('write', write),
+    ('bitmap', bitmap_),
+    ('draw', draw),
+    ('draw aa', draw_aa),
+    ('jpg FAST', jpg_fast),
+    ('jpg SLOW', jpg_slow),
+    ('jpg bytes', jpg_bytes),
+)
+
+
+def run(tft, spi, name, workload):
+    '''
+    Run a workload once and print the bus counters and elapsed time
+    '''
+    spi.reset()
+    start = time.ticks_us()
+    workload(tft)
+    elapsed = time.ticks_diff(time.ticks_us(), start)
+    stats = spi.stats()
+    print('{:<10}'.format(name), end='')
+    for column in COLUMNS:
+        print('{:>11}'.format(stats[column]), end='')
+    print('{:>11}'.format(elapsed))
+    assert stats['bytes'], name + ' sent nothing'
+    assert stats['cs_overlaps'] == 0, name + ' overlapped CS'
+
+
+def main():
+    '''
+    Run all workloads against a MockSPI display
+    '''
+    spi = ili9342c.MockSPI()
+    tft = ili9342c.ILI9342C(spi, 320, 240, dc=0, cs=0)
+    tft.init()
+
+    print('{:<10}'.format('workload'), end='')
+    for column in COLUMNS + ('us',):
+        print('{:>11}'.format(column), end='')
+    print()
+
+    for name, workload in WORKLOADS:
+        run(tft, spi, name, workload)
+
+
+main()
@@ -0,0 +1,66 @@
+'''
+blit_async.py
+
+    Compare blit_buffer() with blit_buffer_async() on a MockSPI bus that
+    takes as long as a 40MHz SPI bus would to send each frame. Each frame is
+    drawn in python while the last one is sent. Requires the unix port built
+    with the driver and the mock bus, see benchmark.py.
+
+        $ ../micropython/ports/unix/build-standard/micropython \\
+            examples/UNIX/blit_async.py
+'''
+
+import time
+import ili9342c
+
+WIDTH = 128
+HEIGHT = 128
+FRAMES = 20
+
+
+def draw_frame(buffer, frame):
+    '''
+    Draw a frame of moving stripes into buffer
+    '''
+    for row in range(HEIGHT):
+        color = ili9342c.color565((row + frame) * 8, 0, 255 - row)
+        hi = color >> 8
+        lo = color & 0xff
+        start = row * WIDTH * 2
+        buffer[start:start + WIDTH * 2] = bytes((hi, lo)) * WIDTH
+
+
+def run(tft, spi, name, blit):
+    '''
+    Draw and send FRAMES frames, printing and returning the time taken and
+    the bus counters
+    '''
+    buffer = bytearray(WIDTH * HEIGHT * 2)
+    spi.reset()
+    start = time.ticks_us()
+    for frame in range(FRAMES):
+        draw_frame(buffer, frame)
+        blit(buffer, 96, 56, WIDTH, HEIGHT)
+    tft.wait()
+    elapsed = time.ticks_diff(time.ticks_us(), start)
+    print('{:<18}{:>10} us/frame'.format(name, elapsed // FRAMES))
+    return elapsed, spi.stats()
+
+
+def main():
+    '''
+    Run the same animation with both blit methods, checking they send the
+    same bytes and that the async one overlaps drawing with sending
+    '''
+    spi = ili9342c.MockSPI(baudrate=40000000)
+    tft = ili9342c.ILI9342C(spi, 320, 240, dc=0, cs=0)
+    tft.init()
+
+    blit_us, blit = run(tft, spi, 'blit_buffer', tft.blit_buffer)
+    async_us, async_ = run(tft, spi, 'blit_buffer_async', tft.blit_buffer_async)
+    assert async_['bytes'] == blit['bytes'], 'blit_buffer_async sent different bytes'
+    assert async_['cs_overlaps'] == 0
+    assert async_us < blit_us, 'blit_buffer_async did not overlap drawing'
+
+
+main()
@@ -0,0 +1,86 @@
+'''
+jpg_decode.py
+
+    Time the jpg decoder on the bigbuckbunny.jpg images in examples/*/bbbunny
+    at each scale and report MCUs decoded per second. The images are read
+    into memory first and drawn on a MockSPI bus without a baudrate, so the
+    times are the decoder's own. Requires the unix port built with the driver
+    and the mock bus, see benchmark.py. Build it a second time with
+    ILI9342C_JPG_FASTDECODE=0 to compare with the bit at a time huffman
+    decoder.
+
+        $ ../micropython/ports/unix/build-standard/micropython \\
+            examples/UNIX/jpg_decode.py
+
+    bigbuckbunny.jpg (c) copyright 2008, Blender Foundation / www.bigbuckbunny.org
+'''
+
+import os
+import time
+import ili9342c
+
+REPEATS = 20
+
+
+def mcus(data):
+    '''
+    Return the number of MCUs in the jpg, from the sampling factors of the
+    first component in its SOF0 segment
+    '''
+    i = 2
+    while i < len(data):
+        marker, length = data[i + 1], data[i + 2] << 8 | data[i + 3]
+        if marker == 0xC0:
+            height = data[i + 5] << 8 | data[i + 6]
+            width = data[i + 7] << 8 | data[i + 8]
+            sampling = data[i + 11]
+            mcu_width, mcu_height = (sampling >> 4) * 8, (sampling & 15) * 8
+            return ((width + mcu_width - 1) // mcu_width) * ((height + mcu_height - 1) // mcu_height)
+        i += 2 + length
+    return 0
+
+
+def images():
+    '''
+    Return the paths of the sample jpgs
+    '''
+    paths = []
+    for name in sorted(os.listdir('examples')):
+        path = 'examples/' + name + '/bbbunny/bigbuckbunny.jpg'
+        try:
+            os.stat(path)
+            paths.append(path)
+        except OSError:
+            pass
+    return paths
+
+
+def main():
+    '''
+    Decode each image REPEATS times at each scale, checking every pixel of
+    it was sent
+    '''
+    spi = ili9342c.MockSPI()
+    tft = ili9342c.ILI9342C(spi, 320, 240, dc=0, cs=0)
+    decoder = ili9342c.JpegDecoder(tft)
+
+    print('{:<44}{:>6}{:>10}{:>12}'.format('jpg', 'scale', 'ms', 'MCUs/s'))
+    for path in images():
+        with open(path, 'rb') as jpg:
+            data = jpg.read()
+        count = mcus(data)
+        width, height = decoder.info(data)
+        for scale in (1, 2, 4, 8):
+            spi.reset()
+            start = time.ticks_us()
+            for _ in range(REPEATS):
+                decoder.decode(data, 0, 0, scale=scale)
+            elapsed = time.ticks_diff(time.ticks_us(), start)
+            print('{:<44}{:>6}{:>10.2f}{:>12}'.format(
+                path, scale, elapsed / REPEATS / 1000,
+                count * REPEATS * 1000000 // elapsed))
+            pixels = min(width // scale, 320) * min(height // scale, 240)
+            assert spi.stats()['data_bytes'] >= REPEATS * pixels * 2, path + ' not all drawn'
+
+
+main()
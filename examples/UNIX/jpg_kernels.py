@@ -0,0 +1,64 @@
+'''
+jpg_kernels.py
+
+    Compare the jpg decoder's IDCT and colour conversion with the reference
+    ones they replaced on the bigbuckbunny.jpg images in examples/*/bbbunny,
+    at each scale. The two should give the same pixels. Requires the unix
+    port built with the driver and the mock bus, see benchmark.py.
+
+        $ ../micropython/ports/unix/build-standard/micropython \\
+            examples/UNIX/jpg_kernels.py
+
+    bigbuckbunny.jpg (c) copyright 2008, Blender Foundation / www.bigbuckbunny.org
+'''
+
+import os
+import time
+import ili9342c
+
+REPEATS = 10
+
+
+def images():
+    '''
+    Return the paths of the sample jpgs
+    '''
+    paths = []
+    for name in sorted(os.listdir('examples')):
+        path = 'examples/' + name + '/bbbunny/bigbuckbunny.jpg'
+        try:
+            os.stat(path)
+            paths.append(path)
+        except OSError:
+            pass
+    return paths
+
+
+def run(data, scale, reference):
+    '''
+    Decode data REPEATS times, returning the pixels and ms/image
+    '''
+    start = time.ticks_us()
+    for _ in range(REPEATS):
+        pixels = ili9342c.jpg_pixels(data, scale, reference)
+    elapsed = time.ticks_diff(time.ticks_us(), start)
+    return pixels, elapsed / REPEATS / 1000
+
+
+def main():
+    '''
+    Time both kernel sets and check they agree
+    '''
+    print('{:<44}{:>6}{:>14}{:>10}{:>8}'.format('jpg', 'scale', 'reference ms', 'tuned ms', 'same'))
+    for path in images():
+        with open(path, 'rb') as jpg:
+            data = jpg.read()
+        for scale in (1, 2, 4, 8):
+            expected, reference = run(data, scale, True)
+            pixels, tuned = run(data, scale, False)
+            print('{:<44}{:>6}{:>14.2f}{:>10.2f}{:>8}'.format(
+                path, scale, reference, tuned, pixels == expected))
+            assert pixels == expected, '{} differs at scale {}'.format(path, scale)
+
+
+main()
@@ -0,0 +1,71 @@
+'''
+mjpeg.py
+
+    Play a Motion JPEG stream with JpegDecoder.play() on a MockSPI bus and
+    print its statistics and frame log. Without an argument the stream is
+    the bigbuckbunny.jpg images in examples/*/bbbunny repeated FRAMES times,
+    otherwise the file given, jpgs one after another or an AVI file. It is
+    played as fast as it decodes, then paced to FPS. Requires the unix port
+    built with the driver and the mock bus, see benchmark.py.
+
+        $ ../micropython/ports/unix/build-standard/micropython \\
+            examples/UNIX/mjpeg.py [video.avi]
+
+    bigbuckbunny.jpg (c) copyright 2008, Blender Foundation / www.bigbuckbunny.org
+'''
+
+import os
+import sys
+import ili9342c
+
+FRAMES = 30
+FPS = 15
+
+
+def stream():
+    '''
+    Return the stream to play, the file given or the sample jpgs one after
+    another, and the number of frames in it, 0 if not known
+    '''
+    if len(sys.argv) > 1:
+        return sys.argv[1], 0
+    frames = []
+    for name in sorted(os.listdir('examples')):
+        path = 'examples/' + name + '/bbbunny/bigbuckbunny.jpg'
+        try:
+            with open(path, 'rb') as jpg:
+                frames.append(jpg.read())
+        except OSError:
+            pass
+    return b''.join(frames) * (FRAMES // len(frames)), FRAMES // len(frames) * len(frames)
+
+
+def play(decoder, video, count, fps):
+    '''
+    Play video at fps, printing the statistics and every tenth frame logged,
+    and check every frame was read and every frame not dropped logged
+    '''
+    log = []
+    stats = decoder.play(video, 0, 0, fps=fps, log=log)
+    print('fps {}: {} frames, {} dropped, {} prepared, {} ms, {} ms decoding, {} ms longest'.format(
+        fps, stats['frames'], stats['dropped'], stats['prepared'], stats['us'] // 1000,
+        stats['decode_us'] // 1000, stats['max_us'] // 1000))
+    for frame, start, decode in log[::10]:
+        print('    frame {:>4} at {:>8} us took {:>6} us'.format(frame, start, decode))
+    assert not count or stats['frames'] == count, 'frames missed'
+    assert len(log) == stats['frames'] - stats['dropped'], 'frames not logged'
+    assert fps or not stats['dropped'], 'frames dropped unpaced'
+
+
+def main():
+    '''
+    Play the stream unpaced, then at FPS
+    '''
+    tft = ili9342c.ILI9342C(ili9342c.MockSPI(), 320, 240, dc=0, cs=0)
+    decoder = ili9342c.JpegDecoder(tft)
+    video, count = stream()
+    play(decoder, video, count, 0)
+    play(decoder, video, count, FPS)
+
+
+main()
@@ -0,0 +1,89 @@
+'''
+shared_bus.py
+
+    Two displays on one MockSPI bus through an ili9342c.Bus, each drawn by
+    its own thread, with a blit_buffer_async() each frame, then a transfer
+    to one display left running while the same thread draws on the other,
+    and a drawing on one display that raises part way through followed by
+    one on the other.
+    The mock bus counts any time a display is selected while the other still
+    is, which the Bus must keep at 0, and the Bus reports how much of the
+    bus each display used. Requires the unix port built with
+    the driver and the mock bus, see benchmark.py.
+
+        $ ../micropython/ports/unix/build-standard/micropython \\
+            examples/UNIX/shared_bus.py
+'''
+
+import time
+import _thread
+import ili9342c
+
+FRAMES = 50
+TILE = 32
+
+running = 0
+running_lock = _thread.allocate_lock()
+
+
+def animate(tft, color):
+    '''
+    Draw FRAMES frames of bars on one display, each ending with a tile sent
+    by blit_buffer_async()
+    '''
+    global running
+    tile = bytes([color >> 8, color & 0xff]) * (TILE * TILE)
+    for frame in range(FRAMES):
+        x = frame * 6 % 280
+        tft.fill_rect(x, 0, 40, 240, color)
+        tft.fill_rect((x + 140) % 280, 0, 40, 240, ili9342c.BLACK)
+        tft.hline(0, frame % 240, 320, ili9342c.WHITE)
+        tft.blit_buffer_async(tile, x, 240 - TILE, TILE, TILE)
+
+    # the last transfer is ended by whichever display uses the bus next
+    with running_lock:
+        running -= 1
+
+
+def main():
+    '''
+    Animate both displays at once, print the bus statistics and check the
+    displays were never selected together
+    '''
+    global running
+    spi = ili9342c.MockSPI(baudrate=40000000)
+    bus = ili9342c.Bus(spi)
+    left = ili9342c.ILI9342C(bus, 320, 240, dc=0, cs=1)
+    right = ili9342c.ILI9342C(bus, 320, 240, dc=0, cs=2)
+
+    running = 2
+    _thread.start_new_thread(animate, (left, ili9342c.RED))
+    _thread.start_new_thread(animate, (right, ili9342c.BLUE))
+    while running:
+        time.sleep_ms(10)
+
+    # drawing on right waits for the transfer to left left running
+    tile = bytes(TILE * TILE * 2)
+    left.blit_buffer_async(tile, 0, 0, TILE, TILE)
+    right.fill_rect(0, 0, TILE, TILE, ili9342c.GREEN)
+
+    # a drawing that raises part way through must leave the bus free
+    try:
+        left.polyline(list(range(400)) + ['x', 0], ili9342c.WHITE)
+    except TypeError:
+        pass
+    else:
+        raise AssertionError('polyline accepted a bad point')
+    right.fill_rect(TILE, 0, TILE, TILE, ili9342c.GREEN)
+
+    overlaps = spi.stats()['cs_overlaps']
+    print('cs_overlaps', overlaps)
+    for name, stats in zip(('left', 'right'), bus.stats()):
+        print('{:<6}{:>9} bytes{:>6} batches{:>9} KB/s{:>9} us waiting'.format(
+            name, stats['bytes'], stats['batches'],
+            stats['bandwidth'] // 1024, stats['wait_us']))
+        assert stats['bytes'], name + ' sent nothing'
+    assert overlaps == 0, 'displays selected together'
+
+
+main()
@@ -0,0 +1,45 @@
+'''
+unpack.py
+
+    Compare the word at a time bit unpacking used by write(), bitmap() and
+    Sprite() with the bit at a time reference it replaced, for each bits per
+    pixel used by font and bitmap modules. Requires the unix port built with
+    the driver and the mock bus, see benchmark.py.
+
+        $ ../micropython/ports/unix/build-standard/micropython \\
+            examples/UNIX/unpack.py
+'''
+
+import time
+import ili9342c
+
+PIXELS = 32 * 32
+REPEATS = 200
+
+
+def run(data, bpp, reference):
+    '''
+    Unpack PIXELS pixels REPEATS times, returning the pixels and ns/pixel
+    '''
+    start = time.ticks_us()
+    for _ in range(REPEATS):
+        pixels = ili9342c.unpack(data, bpp, PIXELS, reference)
+    elapsed = time.ticks_diff(time.ticks_us(), start)
+    return pixels, elapsed * 1000 // (REPEATS * PIXELS)
+
+
+def main():
+    '''
+    Time both unpackers and check they agree
+    '''
+    data = bytes((i * 37 + 11) & 0xff for i in range(PIXELS))
+
+    print('{:<6}{:>14}{:>14}{:>8}'.format('bpp', 'reference ns', 'unpack ns', 'same'))
+    for bpp in (1, 2, 4, 8):
+        expected, reference = run(data, bpp, True)
+        pixels, unpack = run(data, bpp, False)
+        print('{:<6}{:>14}{:>14}{:>8}'.format(bpp, reference, unpack, pixels == expected))
+        assert pixels == expected, 'unpack differs at {} bpp'.format(bpp)
+
+
+main()
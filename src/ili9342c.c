@@ -29,6 +29,7 @@
 
 #define __ILI9342C_VERSION__ "0.0.4"
 #include <stdlib.h>
+#include <limits.h>
 #include <math.h>
 #include <stdio.h>
 #include <string.h>
@@ -38,6 +39,7 @@
 #include "py/runtime.h"
 #include "py/builtin.h"
 #include "py/mphal.h"
+#include "py/mpthread.h"
 
 // Fix for MicroPython > 1.21 https://github.com/ricksorensen
 #if MICROPY_VERSION_MAJOR >= 1 && MICROPY_VERSION_MINOR > 21
@@ -50,6 +52,37 @@
 #include "ili9342c.h"
 #include "tjpgd565.h"
 
+#ifdef ILI9342C_MOCK_SPI
+#include "mockspi.h"
+#endif
+
+// blit_buffer_async() transfers are run by a FreeRTOS task on the ESP32 so
+// python keeps running while the SPI DMA sends the buffer
+#ifndef ILI9342C_ASYNC_TASK
+#if defined(ESP_PLATFORM) && !defined(ILI9342C_MOCK_SPI)
+#define ILI9342C_ASYNC_TASK 1
+#else
+#define ILI9342C_ASYNC_TASK 0
+#endif
+#endif
+
+#if ILI9342C_ASYNC_TASK
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+// the hardware SPI, the only bus the task drives: its transfer() raises only
+// on a deinitialised bus, which async_start() finds first on the calling
+// thread, where python can catch it
+#if MICROPY_VERSION_MAJOR >= 1 && MICROPY_VERSION_MINOR > 21
+#define ASYNC_SPI_TYPE machine_spi_type
+#else
+extern const mp_obj_type_t machine_hw_spi_type;
+#define ASYNC_SPI_TYPE machine_hw_spi_type
+#endif
+#endif
+
 #define _swap_int16_t(a, b) \
 	{                       \
 		int16_t t = a;      \
@@ -57,26 +90,52 @@
 		b		  = t;      \
 	}
 
+#define _swap_int64_t(a, b) \
+	{                       \
+		int64_t t = a;      \
+		a		  = b;      \
+		b		  = t;      \
+	}
+
 #define _swap_bytes(val) ((((val) >> 8) & 0x00FF) | (((val) << 8) & 0xFF00))
 #define ABS(N) (((N) < 0) ? (-(N)) : (N))
 #define mp_hal_delay_ms(delay) (mp_hal_delay_us(delay * 1000))
 
+#ifdef ILI9342C_MOCK_SPI
+#define CS_WRITE(value) mockspi_cs_write(self->spi_obj, self->cs, value)
+#define DC_WRITE(value) mockspi_dc_write(self->spi_obj, value)
+#else
+#define CS_WRITE(value) mp_hal_pin_write(self->cs, value)
+#define DC_WRITE(value) mp_hal_pin_write(self->dc, value)
+#endif
+
 #define CS_LOW()                           \
 	{                                      \
 		if (self->cs) {                    \
-			mp_hal_pin_write(self->cs, 0); \
+			CS_WRITE(0);                   \
 		}                                  \
 	}
 
 #define CS_HIGH()                          \
 	{                                      \
 		if (self->cs) {                    \
-			mp_hal_pin_write(self->cs, 1); \
+			CS_WRITE(1);                   \
 		}                                  \
 	}
 
-#define DC_LOW() (mp_hal_pin_write(self->dc, 0))
-#define DC_HIGH() (mp_hal_pin_write(self->dc, 1))
+#define DC_LOW() (DC_WRITE(0))
+#define DC_HIGH() (DC_WRITE(1))
+
+// Writes shorter than this are collected in the command queue, longer ones
+// are sent straight from the callers buffer
+#ifndef ILI9342C_QUEUE_SIZE
+#define ILI9342C_QUEUE_SIZE 64
+#endif
+
+// Default size in bytes of the solid color pattern sent by fills
+#ifndef ILI9342C_FILL_BUFFER
+#define ILI9342C_FILL_BUFFER 4096
+#endif
 
 #define RESET_LOW()                           \
 	{                                         \
@@ -90,10 +149,58 @@
 			mp_hal_pin_write(self->reset, 1); \
 	}
 
+// Number of dirty rectangles tracked in framebuffer mode before the closest
+// ones are merged together
+#ifndef ILI9342C_DIRTY_RECTS
+#define ILI9342C_DIRTY_RECTS 8
+#endif
+
+// Rows rendered at a time in band mode, fewer if they would not fit in
+// buffer_size bytes
+#ifndef ILI9342C_BAND_HEIGHT
+#define ILI9342C_BAND_HEIGHT 16
+#endif
+
+// Default size in bytes of the write() glyph cache, 0 to disable it
+#ifndef ILI9342C_GLYPH_CACHE
+#define ILI9342C_GLYPH_CACHE 0
+#endif
+
+// Hash chains in the glyph cache
+#define GLYPH_BUCKETS 32
+
+// Lock each display for the thread calling its methods, 0 to leave threads
+// sharing a display to serialise their calls themselves
+#ifndef ILI9342C_THREAD_SAFE
+#define ILI9342C_THREAD_SAFE MICROPY_PY_THREAD
+#endif
+
+// inclusive rectangle in logical display coordinates
+typedef struct _ili9342c_rect_t {
+	uint16_t x0, y0, x1, y1;
+} ili9342c_rect_t;
+
+// rendered write() glyph, ready to send
+typedef struct _ili9342c_glyph_t {
+	struct _ili9342c_glyph_t *newer;	// LRU order
+	struct _ili9342c_glyph_t *older;
+	struct _ili9342c_glyph_t *chain;	// next in the hash bucket
+	mp_obj_t		 font;				// font module
+	uint16_t		 index;				// glyph in the font
+	uint16_t		 fg_color;			// byte swapped colors
+	uint16_t		 bg_color;
+	uint16_t		 size;				// bytes allocated for the entry
+	uint16_t		 pixels[];			// width * height RGB565 pixels
+} ili9342c_glyph_t;
+
+typedef struct _ili9342c_Bus_obj_t ili9342c_Bus_obj_t;
+typedef struct _ili9342c_JpegDecoder_obj_t ili9342c_JpegDecoder_obj_t;
+
 // this is the actual C-structure for our new object
 typedef struct _ili9342c_ILI9342C_obj_t {
 	mp_obj_base_t	 base;
 	mp_obj_base_t   *spi_obj;
+	ili9342c_Bus_obj_t *bus;			// bus shared with other displays, or NULL
 	mp_file_t		*fp;				// file object
 	uint16_t		*i2c_buffer;		// resident buffer if buffer_size given
 	uint16_t	 	 buffer_size;		// resident buffer size, 0=dynamic
@@ -106,11 +213,89 @@ typedef struct _ili9342c_ILI9342C_obj_t {
 	mp_hal_pin_obj_t dc;
 	mp_hal_pin_obj_t cs;
 	mp_hal_pin_obj_t backlight;
+	uint32_t		 max_transfer;		// largest single SPI transfer, 0=no limit
+	uint16_t		*fill_buffer;		// solid color pattern for fills
+	uint32_t		 fill_size;			// pixels in fill_buffer
+	uint32_t		 fill_count;		// pixels of fill_color set in fill_buffer
+	uint16_t		 fill_color;		// byte swapped color in fill_buffer
+	bool			 cs_active;			// CS asserted by the command queue
+	uint8_t			 queue_dc;			// DC level of the queued bytes
+	uint16_t		 queue_len;			// bytes waiting in the queue
+	uint8_t			 queue[ILI9342C_QUEUE_SIZE];	// command queue
+	bool			 window_valid;		// window_x/y match the display
+	uint16_t		 window_x0;			// last CASET column range
+	uint16_t		 window_x1;
+	uint16_t		 window_y0;			// last PASET page range
+	uint16_t		 window_y1;
+	uint16_t		*frame_buffer;		// RGB565 frame in framebuffer mode, else NULL
+	ili9342c_rect_t	 fb_window;			// window being drawn into the frame buffer
+	bool			 fb_window_valid;	// false if the last window was off screen
+	uint16_t		 fb_x;				// next pixel written in fb_window
+	uint16_t		 fb_y;
+	uint16_t		 fb_top;			// first row held in frame_buffer
+	uint16_t		 fb_bottom;			// last row held in frame_buffer
+	uint8_t			 dirty_count;		// rectangles in dirty
+	ili9342c_rect_t	 dirty[ILI9342C_DIRTY_RECTS];	// areas changed since the last show()
+	uint8_t			*display_list;		// drawing recorded in band mode, else NULL
+	uint32_t		 dl_size;			// display list size in bytes
+	uint32_t		 dl_len;			// display list bytes used
+	ili9342c_rect_t	 dl_window;			// window being recorded
+	bool			 dl_window_valid;	// false if the last window was off screen
+	uint32_t		 dl_offset;			// pixels recorded in dl_window so far
+	uint16_t		*band;				// band_rows rows rendered by show()
+	uint16_t		 band_rows;			// rows in band
+	uint8_t			*async_buffer[2];	// blit_buffer_async ping-pong buffers
+	uint32_t		 async_size[2];		// bytes allocated for each async_buffer
+	uint8_t			 async_next;		// async_buffer the next call fills
+	bool			 async_busy;		// transfer may still run, CS still asserted
+	ili9342c_glyph_t *glyph_buckets[GLYPH_BUCKETS];	// cached glyphs by hash
+	ili9342c_glyph_t *glyph_newest;		// most recently used glyph
+	ili9342c_glyph_t *glyph_oldest;		// next glyph to evict
+	uint32_t		 glyph_budget;		// glyph cache size in bytes, 0=disabled
+	uint32_t		 glyph_bytes;		// bytes held by cached glyphs
+	uint32_t		 glyph_count;		// glyphs cached
+	uint32_t		 glyph_hits;		// write() glyphs found in the cache
+	uint32_t		 glyph_misses;		// write() glyphs rendered
+#if ILI9342C_THREAD_SAFE
+	mp_thread_mutex_t lock;				// held by the thread drawing
+	void			*lock_owner;		// mp_thread_get_state() of that thread
+	uint16_t		 lock_depth;		// nested calls and with blocks holding lock
+#endif
+	uint32_t		 bus_bytes;			// bytes sent on the shared bus
+	uint32_t		 bus_transfers;		// SPI transfers on the shared bus
+	uint32_t		 bus_batches;		// times the shared bus was taken
+	uint32_t		 bus_wait_us;		// time spent waiting for the shared bus
+	uint32_t		 bus_busy_us;		// time the shared bus was held
+	mp_uint_t		 bus_start;			// ticks_us() the shared bus was taken
+#if ILI9342C_ASYNC_TASK
+	SemaphoreHandle_t async_done;		// given by the task when the transfer ends
+	bool			 async_queued;		// transfer sent to the task, async_done pending
+#endif
 } ili9342c_ILI9342C_obj_t;
 
 
+// Most displays that can share one SPI bus
+#ifndef ILI9342C_BUS_DEVICES
+#define ILI9342C_BUS_DEVICES 4
+#endif
+
+// SPI bus shared by several displays
+struct _ili9342c_Bus_obj_t {
+	mp_obj_base_t	 base;
+	mp_obj_base_t	*spi_obj;
+	ili9342c_ILI9342C_obj_t *owner;		// display with its CS asserted, or NULL
+	ili9342c_ILI9342C_obj_t *devices[ILI9342C_BUS_DEVICES];	// in the order added
+	uint8_t			 count;				// displays in devices
+	ili9342c_ILI9342C_obj_t *async;		// display with a blit_buffer_async() left running, or NULL
+#if ILI9342C_THREAD_SAFE
+	mp_thread_mutex_t lock;				// held by owner
+#endif
+};
+
 // forward reference prototype
 mp_obj_t ili9342c_ILI9342C_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *args);
+extern const mp_obj_type_t ili9342c_ILI9342C_type;
+extern const mp_obj_type_t ili9342c_JpegDecoder_type;
 
 //
 //  methods start
@@ -123,1210 +308,4955 @@ static void ili9342c_ILI9342C_print(const mp_print_t *print, mp_obj_t self_in, m
     mp_printf(print, "<ILI9342C  width=%u, height=%u, spi=%p>", self->width, self->height, self->spi_obj);
 }
 
-static void write_spi(mp_obj_base_t *spi_obj, const uint8_t *buf, int len) {
+// send len bytes in transfers of at most max_transfer bytes, 0 for no limit
+static void write_spi(mp_obj_base_t *spi_obj, const uint8_t *buf, size_t len, size_t max_transfer) {
     #ifdef MP_OBJ_TYPE_GET_SLOT
     mp_machine_spi_p_t *spi_p = (mp_machine_spi_p_t *)MP_OBJ_TYPE_GET_SLOT(spi_obj->type, protocol);
     #else
     mp_machine_spi_p_t *spi_p = (mp_machine_spi_p_t *)spi_obj->type->protocol;
     #endif
+    if (max_transfer == 0) {
+        max_transfer = len;
+    }
+    while (len > max_transfer) {
+        spi_p->transfer(spi_obj, max_transfer, buf, NULL);
+        buf += max_transfer;
+        len -= max_transfer;
+    }
     spi_p->transfer(spi_obj, len, buf, NULL);
 }
 
-static void write_cmd(ili9342c_ILI9342C_obj_t *self, uint8_t cmd, const uint8_t *data, int len) {
-	CS_LOW()
-	if (cmd) {
-		DC_LOW();
-		write_spi(self->spi_obj, &cmd, 1);
-	}
-	if (len > 0) {
-		DC_HIGH();
-		write_spi(self->spi_obj, data, len);
-	}
-	CS_HIGH()
-}
+//
+// Locks
+//
+// display_lock() holds a display for the calling thread, see Thread safety.
+// Displays given a Bus take it when they assert CS and release it with CS,
+// so their transfers never interleave. Threads waiting for the bus are
+// served in the order the port's mutex queues them, first come first served
+// between equal priority tasks on the ESP32. The transfers and time each
+// display has used the bus for are counted for Bus.stats().
+//
+// The bus lock is a mutex, so it is given up by the method that took it,
+// on the same thread. A blit_buffer_async() transfer still running then is
+// left with its CS low as the bus's async display, and whichever display
+// takes the bus next, from any thread, waits for it to end and releases its
+// CS first. A display without a Bus does the same with its own transfer.
+//
 
-static void set_window(ili9342c_ILI9342C_obj_t *self, uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1) {
-	if (x0 > x1 || x1 >= self->width) {
-		return;
-	}
-	if (y0 > y1 || y1 >= self->height) {
-		return;
-	}
-	uint8_t bufx[4] = {x0 >> 8, x0 & 0xFF, x1 >> 8, x1 & 0xFF};
-	uint8_t bufy[4] = {y0 >> 8, y0 & 0xFF, y1 >> 8, y1 & 0xFF};
-	write_cmd(self, ILI9342C_CASET, bufx, 4);
-	write_cmd(self, ILI9342C_PASET, bufy, 4);
-	write_cmd(self, ILI9342C_RAMWR, NULL, 0);
-}
+#if ILI9342C_THREAD_SAFE
 
-static void fill_color_buffer(mp_obj_base_t *spi_obj, uint16_t color, int length) {
-	const int buffer_pixel_size = 128;
-	int		  chunks			= length / buffer_pixel_size;
-	int		  rest				= length % buffer_pixel_size;
-	uint16_t  color_swapped		= _swap_bytes(color);
-	uint16_t  buffer[buffer_pixel_size]; // 128 pixels
+static void display_lock(ili9342c_ILI9342C_obj_t *self) {
+	void *thread = mp_thread_get_state();
 
-	// fill buffer with color data
-	for (int i = 0; i < length && i < buffer_pixel_size; i++) {
-		buffer[i] = color_swapped;
-	}
-	if (chunks) {
-		for (int j = 0; j < chunks; j++) {
-			write_spi(spi_obj, (uint8_t *) buffer, buffer_pixel_size * 2);
+	if (self->lock_owner != thread) {
+		if (!mp_thread_mutex_lock(&self->lock, 0)) {
+			MP_THREAD_GIL_EXIT();
+			mp_thread_mutex_lock(&self->lock, 1);
+			MP_THREAD_GIL_ENTER();
 		}
+		self->lock_owner = thread;
 	}
-	if (rest) {
-		write_spi(spi_obj, (uint8_t *) buffer, rest * 2);
-	}
+	self->lock_depth++;
 }
 
-static void draw_pixel(ili9342c_ILI9342C_obj_t *self, uint16_t x, uint16_t y, uint16_t color) {
-	uint8_t hi = color >> 8, lo = color;
-	set_window(self, x, y, x, y);
-	DC_HIGH();
-	CS_LOW();
-	write_spi(self->spi_obj, &hi, 1);
-	write_spi(self->spi_obj, &lo, 1);
-	CS_HIGH();
+static void display_unlock(ili9342c_ILI9342C_obj_t *self) {
+	if (self->lock_owner == mp_thread_get_state() && --self->lock_depth == 0) {
+		self->lock_owner = NULL;
+		mp_thread_mutex_unlock(&self->lock);
+	}
 }
 
-static void fast_hline(ili9342c_ILI9342C_obj_t *self, uint16_t x, uint16_t y, uint16_t _w, uint16_t color) {
-	int w;
+#else
 
-	if (x + _w > self->width)
-		w = self->width - x;
-	else
-		w = _w;
+#define display_lock(self) ((void) (self))
+#define display_unlock(self) ((void) (self))
 
-	if (w > 0) {
-		set_window(self, x, y, x + w - 1, y);
-		DC_HIGH();
-		CS_LOW();
-		fill_color_buffer(self->spi_obj, color, w);
-		CS_HIGH();
-	}
-}
+#endif
 
-static void fast_vline(ili9342c_ILI9342C_obj_t *self, uint16_t x, uint16_t y, uint16_t w, uint16_t color) {
-	set_window(self, x, y, x, y + w - 1);
-	DC_HIGH();
-	CS_LOW();
-	fill_color_buffer(self->spi_obj, color, w);
-	CS_HIGH();
-}
+static void async_end(ili9342c_ILI9342C_obj_t *self);
 
-static mp_obj_t ili9342c_ILI9342C_hard_reset(mp_obj_t self_in) {
-	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(self_in);
+#if ILI9342C_THREAD_SAFE
 
-	CS_LOW();
-	RESET_HIGH();
-	mp_hal_delay_ms(50);
-	RESET_LOW();
-	mp_hal_delay_ms(50);
-	RESET_HIGH();
-	mp_hal_delay_ms(150);
-	CS_HIGH();
-	return mp_const_none;
+static void bus_lock(ili9342c_Bus_obj_t *bus) {
+	if (!mp_thread_mutex_lock(&bus->lock, 0)) {
+		MP_THREAD_GIL_EXIT();
+		mp_thread_mutex_lock(&bus->lock, 1);
+		MP_THREAD_GIL_ENTER();
+	}
 }
 
-static mp_obj_t ili9342c_ILI9342C_soft_reset(mp_obj_t self_in) {
-	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(self_in);
+#define bus_unlock(bus) mp_thread_mutex_unlock(&(bus)->lock)
 
-	write_cmd(self, ILI9342C_SWRESET, NULL, 0);
-	mp_hal_delay_ms(150);
-	return mp_const_none;
-}
+#else
 
-/*
-static mp_obj_t ili9342c_ILI9342C_write(mp_obj_t self_in, mp_obj_t command, mp_obj_t data) {
-	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(self_in);
-	mp_buffer_info_t		 src;
+#define bus_lock(bus) ((void) (bus))
+#define bus_unlock(bus) ((void) (bus))
 
-	if (data == mp_const_none) {
-		write_cmd(self, (uint8_t) mp_obj_get_int(command), NULL, 0);
-	} else {
-		mp_get_buffer_raise(data, &src, MP_BUFFER_READ);
-		write_cmd(self, (uint8_t) mp_obj_get_int(command), (const uint8_t *) src.buf, src.len);
-	}
-	return mp_const_none;
-}
+#endif
 
-MP_DEFINE_CONST_FUN_OBJ_3(ili9342c_ILI9342C_write_obj, ili9342c_ILI9342C_write);
-*/
+// take the bus for self once any blit_buffer_async() left running on it has ended
+static void bus_acquire(ili9342c_ILI9342C_obj_t *self) {
+	ili9342c_Bus_obj_t *bus = self->bus;
+	if (bus == NULL) {
+		async_end(self);
+		return;
+	}
 
-MP_DEFINE_CONST_FUN_OBJ_1(ili9342c_ILI9342C_hard_reset_obj, ili9342c_ILI9342C_hard_reset);
-MP_DEFINE_CONST_FUN_OBJ_1(ili9342c_ILI9342C_soft_reset_obj, ili9342c_ILI9342C_soft_reset);
+	mp_uint_t start = mp_hal_ticks_us();
 
-static mp_obj_t ili9342c_ILI9342C_sleep_mode(mp_obj_t self_in, mp_obj_t value) {
-	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(self_in);
-	if (mp_obj_is_true(value)) {
-		write_cmd(self, ILI9342C_SLPIN, NULL, 0);
-	} else {
-		write_cmd(self, ILI9342C_SLPOUT, NULL, 0);
+	bus_lock(bus);
+	if (bus->async) {
+		async_end(bus->async);
+		bus->async = NULL;
 	}
-	return mp_const_none;
+	bus->owner = self;
+	self->bus_start = mp_hal_ticks_us();
+	self->bus_wait_us += self->bus_start - start;
+	self->bus_batches++;
 }
-MP_DEFINE_CONST_FUN_OBJ_2(ili9342c_ILI9342C_sleep_mode_obj, ili9342c_ILI9342C_sleep_mode);
-
-static mp_obj_t ili9342c_ILI9342C_set_window(size_t n_args, const mp_obj_t *args) {
-	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
 
-	mp_int_t x0 = mp_obj_get_int(args[1]);
-	mp_int_t x1 = mp_obj_get_int(args[2]);
-	mp_int_t y0 = mp_obj_get_int(args[3]);
-	mp_int_t y1 = mp_obj_get_int(args[4]);
+static void bus_release(ili9342c_ILI9342C_obj_t *self) {
+	ili9342c_Bus_obj_t *bus = self->bus;
+	if (bus == NULL || bus->owner != self) {
+		return;
+	}
 
-	set_window(self, x0, y0, x1, y1);
-	return mp_const_none;
+	self->bus_busy_us += mp_hal_ticks_us() - self->bus_start;
+	bus->owner = NULL;
+	bus_unlock(bus);
 }
-static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_set_window_obj, 5, 5, ili9342c_ILI9342C_set_window);
-static mp_obj_t ili9342c_ILI9342C_inversion_mode(mp_obj_t self_in, mp_obj_t value) {
-	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(self_in);
 
-	if (mp_obj_is_true(value)) {
-		write_cmd(self, ILI9342C_INVON, NULL, 0);
-	} else {
-		write_cmd(self, ILI9342C_INVOFF, NULL, 0);
+// count a write of len bytes on a shared bus
+static void bus_count(ili9342c_ILI9342C_obj_t *self, size_t len) {
+	if (self->bus) {
+		self->bus_bytes += len;
+		self->bus_transfers += (self->max_transfer && len) ? (len + self->max_transfer - 1) / self->max_transfer : 1;
 	}
-	return mp_const_none;
 }
-MP_DEFINE_CONST_FUN_OBJ_2(ili9342c_ILI9342C_inversion_mode_obj, ili9342c_ILI9342C_inversion_mode);
-
-static mp_obj_t ili9342c_ILI9342C_fill_rect(size_t n_args, const mp_obj_t *args) {
-	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
 
-	mp_int_t x	   = mp_obj_get_int(args[1]);
-	mp_int_t y	   = mp_obj_get_int(args[2]);
-	mp_int_t w	   = mp_obj_get_int(args[3]);
-	mp_int_t h	   = mp_obj_get_int(args[4]);
-	mp_int_t color = mp_obj_get_int(args[5]);
+static void display_write(ili9342c_ILI9342C_obj_t *self, const uint8_t *buf, size_t len) {
+	bus_count(self, len);
+	write_spi(self->spi_obj, buf, len, self->max_transfer);
+}
 
-	set_window(self, x, y, x + w - 1, y + h - 1);
-	DC_HIGH();
-	CS_LOW();
-	fill_color_buffer(self->spi_obj, color, w * h);
-	CS_HIGH();
+//
+// Asynchronous transfers
+//
+// async_start() sends a buffer with DC high under the CS already asserted by
+// the command queue and returns, where the bus allows it, while the transfer
+// is still running, giving up the bus but leaving CS low. async_end() waits
+// for it to complete and releases CS. The command queue ends it before
+// taking the bus, so only blit_buffer_async() needs to know about it.
+//
+// The ESP32 task runs outside python, where nothing can catch an exception,
+// so it only sends on a hardware SPI; a SoftSPI, or anything else with the
+// SPI protocol, is sent before async_start() returns.
+//
 
-	return mp_const_none;
-}
-static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_fill_rect_obj, 6, 6, ili9342c_ILI9342C_fill_rect);
+#if ILI9342C_ASYNC_TASK
 
-static mp_obj_t ili9342c_ILI9342C_fill(mp_obj_t self_in, mp_obj_t _color) {
-	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(self_in);
+typedef struct _async_job_t {
+	mp_obj_base_t	 *spi_obj;
+	const uint8_t	 *buf;
+	size_t			  len;
+	size_t			  max_transfer;
+	SemaphoreHandle_t done;
+} async_job_t;
 
-	mp_int_t color = mp_obj_get_int(_color);
+static QueueHandle_t async_jobs = NULL;
 
-	set_window(self, 0, 0, self->width - 1, self->height - 1);
-	DC_HIGH();
-	CS_LOW();
-	fill_color_buffer(self->spi_obj, color, self->width * self->height);
-	CS_HIGH();
+static void async_task(void *arg) {
+	(void) arg;
+	async_job_t job;
 
-	return mp_const_none;
+	for (;;) {
+		if (xQueueReceive(async_jobs, &job, portMAX_DELAY) == pdTRUE) {
+			write_spi(job.spi_obj, job.buf, job.len, job.max_transfer);
+			xSemaphoreGive(job.done);
+		}
+	}
 }
-static MP_DEFINE_CONST_FUN_OBJ_2(ili9342c_ILI9342C_fill_obj, ili9342c_ILI9342C_fill);
 
-static mp_obj_t ili9342c_ILI9342C_pixel(size_t n_args, const mp_obj_t *args) {
-	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
-
-	mp_int_t x	   = mp_obj_get_int(args[1]);
-	mp_int_t y	   = mp_obj_get_int(args[2]);
-	mp_int_t color = mp_obj_get_int(args[3]);
+#endif
 
-	draw_pixel(self, x, y, color);
+static void async_start(ili9342c_ILI9342C_obj_t *self, const uint8_t *buf, size_t len) {
+#if ILI9342C_ASYNC_TASK
+	// the first pixel is sent here, so a deinitialised bus raises in python
+	size_t head = MIN(len, 2);
+	if (head) {
+		write_spi(self->spi_obj, buf, head, self->max_transfer);
+	}
+	if (len > head && self->spi_obj->type != &ASYNC_SPI_TYPE) {
+		write_spi(self->spi_obj, buf + head, len - head, self->max_transfer);
+	} else if (len > head) {
+		if (async_jobs == NULL) {
+			async_jobs = xQueueCreate(2, sizeof(async_job_t));
+			if (async_jobs == NULL || xTaskCreate(async_task, "ili9342c", 2048, NULL, uxTaskPriorityGet(NULL), NULL) != pdPASS) {
+				mp_raise_msg(&mp_type_OSError, MP_ERROR_TEXT("unable to start async task"));
+			}
+		}
+		if (self->async_done == NULL) {
+			self->async_done = xSemaphoreCreateBinary();
+			if (self->async_done == NULL) {
+				mp_raise_msg(&mp_type_OSError, MP_ERROR_TEXT("unable to start async task"));
+			}
+		}
+		async_job_t job = {self->spi_obj, buf + head, len - head, self->max_transfer, self->async_done};
+		xQueueSend(async_jobs, &job, portMAX_DELAY);
+		self->async_queued = true;
+	}
+#else
+#ifdef ILI9342C_MOCK_SPI
+	if (self->spi_obj->type == &ili9342c_MockSPI_type) {
+		mockspi_start(self->spi_obj, buf, len);
+	} else {
+		write_spi(self->spi_obj, buf, len, self->max_transfer);
+	}
+#else
+	write_spi(self->spi_obj, buf, len, self->max_transfer);
+#endif
+#endif
+	bus_count(self, len);
+	self->async_busy = true;
 
-	return mp_const_none;
+	// CS stays low until whoever takes the bus next ends the transfer
+	self->cs_active = false;
+	if (self->bus) {
+		self->bus->async = self;
+	}
+	bus_release(self);
 }
-static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_pixel_obj, 4, 4, ili9342c_ILI9342C_pixel);
 
-static void line(ili9342c_ILI9342C_obj_t *self, int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t color) {
-	bool steep = ABS(y1 - y0) > ABS(x1 - x0);
-	if (steep) {
-		_swap_int16_t(x0, y0);
-		_swap_int16_t(x1, y1);
+// wait for self's transfer, called holding the bus or, without one, the display
+static void async_end(ili9342c_ILI9342C_obj_t *self) {
+	if (!self->async_busy) {
+		return;
 	}
-
-	if (x0 > x1) {
-		_swap_int16_t(x0, x1);
-		_swap_int16_t(y0, y1);
+#if ILI9342C_ASYNC_TASK
+	if (self->async_queued) {
+		MP_THREAD_GIL_EXIT();
+		xSemaphoreTake(self->async_done, portMAX_DELAY);
+		MP_THREAD_GIL_ENTER();
+		self->async_queued = false;
 	}
+#elif defined(ILI9342C_MOCK_SPI)
+	mockspi_wait(self->spi_obj);
+#endif
+	self->async_busy = false;
+	CS_HIGH();
+}
 
-	int16_t dx = x1 - x0, dy = ABS(y1 - y0);
-	int16_t err = dx >> 1, ystep = -1, xs = x0, dlen = 0;
+// wait for a blit_buffer_async() to self, or any display on its bus, to end
+static void async_wait(ili9342c_ILI9342C_obj_t *self) {
+	ili9342c_Bus_obj_t *bus = self->bus;
+	if (bus == NULL) {
+		async_end(self);
+		return;
+	}
+	bus_lock(bus);
+	if (bus->async) {
+		async_end(bus->async);
+		bus->async = NULL;
+	}
+	bus_unlock(bus);
+}
 
-	if (y0 < y1)
-		ystep = 1;
+//
+// Command queue
+//
+// Commands and data are queued as DC segments under a single CS assertion.
+// Consecutive writes at the same DC level are packed into one transfer, so
+// a set_window() and the pixel data that follows it go out as one
+// transaction. The queue is sent when full, and queue_flush() sends what is
+// left and releases CS. Every method that writes to the display must call
+// queue_flush() before returning or handing control back to python, since
+// other devices may share the SPI bus.
+//
 
-	// Split into steep and not steep for FastH/V separation
-	if (steep) {
-		for (; x0 <= x1; x0++) {
-			dlen++;
-			err -= dy;
-			if (err < 0) {
-				err += dx;
-				if (dlen == 1)
-					draw_pixel(self, y0, xs, color);
-				else
-					fast_vline(self, y0, xs, dlen, color);
-				dlen = 0;
-				y0 += ystep;
-				xs = x0 + 1;
-			}
-		}
-		if (dlen)
-			fast_vline(self, y0, xs, dlen, color);
-	} else {
-		for (; x0 <= x1; x0++) {
-			dlen++;
-			err -= dy;
-			if (err < 0) {
-				err += dx;
-				if (dlen == 1)
-					draw_pixel(self, xs, y0, color);
-				else
-					fast_hline(self, xs, y0, dlen, color);
-				dlen = 0;
-				y0 += ystep;
-				xs = x0 + 1;
-			}
+static void queue_send(ili9342c_ILI9342C_obj_t *self) {
+	if (self->queue_len) {
+		if (self->queue_dc) {
+			DC_HIGH();
+		} else {
+			DC_LOW();
 		}
-		if (dlen)
-			fast_hline(self, xs, y0, dlen, color);
+		display_write(self, self->queue, self->queue_len);
+		self->queue_len = 0;
 	}
 }
 
+static void queue_write(ili9342c_ILI9342C_obj_t *self, uint8_t dc, const uint8_t *data, int len) {
+	if (!self->cs_active) {
+		bus_acquire(self);
+		CS_LOW();
+		self->cs_active = true;
+	}
 
-static mp_obj_t ili9342c_ILI9342C_line(size_t n_args, const mp_obj_t *args) {
-	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+	if (len <= 0) {
+		return;
+	}
 
-	mp_int_t x0	   = mp_obj_get_int(args[1]);
-	mp_int_t y0	   = mp_obj_get_int(args[2]);
-	mp_int_t x1	   = mp_obj_get_int(args[3]);
-	mp_int_t y1	   = mp_obj_get_int(args[4]);
-	mp_int_t color = mp_obj_get_int(args[5]);
+	if (self->queue_len && (self->queue_dc != dc || self->queue_len + len > ILI9342C_QUEUE_SIZE)) {
+		queue_send(self);
+	}
 
-	line(self, x0, y0, x1, y1, color);
+	self->queue_dc = dc;
+	if (len >= ILI9342C_QUEUE_SIZE) {
+		if (dc) {
+			DC_HIGH();
+		} else {
+			DC_LOW();
+		}
+		display_write(self, data, len);
+	} else {
+		memcpy(self->queue + self->queue_len, data, len);
+		self->queue_len += len;
+	}
+}
 
-	return mp_const_none;
+static void queue_flush(ili9342c_ILI9342C_obj_t *self) {
+	queue_send(self);
+	if (self->cs_active) {
+		CS_HIGH();
+		self->cs_active = false;
+		bus_release(self);
+	}
 }
 
-static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_line_obj, 6, 6, ili9342c_ILI9342C_line);
-
-static mp_obj_t ili9342c_ILI9342C_blit_buffer(size_t n_args, const mp_obj_t *args) {
-	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
-
-	mp_buffer_info_t buf_info;
-	mp_get_buffer_raise(args[1], &buf_info, MP_BUFFER_READ);
-	mp_int_t x = mp_obj_get_int(args[2]);
-	mp_int_t y = mp_obj_get_int(args[3]);
-	mp_int_t w = mp_obj_get_int(args[4]);
-	mp_int_t h = mp_obj_get_int(args[5]);
+static void write_cmd(ili9342c_ILI9342C_obj_t *self, uint8_t cmd, const uint8_t *data, int len) {
+	if (cmd) {
+		queue_write(self, 0, &cmd, 1);
+	}
+	if (len > 0) {
+		queue_write(self, 1, data, len);
+	}
+}
 
-	set_window(self, x, y, x + w - 1, y + h - 1);
-	DC_HIGH();
-	CS_LOW();
+//
+// Framebuffer mode
+//
+// set_window() and the pixel writes are redirected into the frame buffer,
+// the same way the display would place them in its own memory, and each
+// window is added to the dirty list. show() sends the dirty rectangles.
+//
 
-	const int buf_size = 256;
-	int		  limit	   = MIN(buf_info.len, w * h * 2);
-	int		  chunks   = limit / buf_size;
-	int		  rest	   = limit % buf_size;
-	int		  i		   = 0;
+static void dirty_add(ili9342c_ILI9342C_obj_t *self, uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1) {
+	ili9342c_rect_t r = {x0, y0, x1, y1};
+
+	for (;;) {
+		// merge with any rectangle that overlaps or touches this one
+		bool merged = false;
+		for (int i = 0; i < self->dirty_count; i++) {
+			ili9342c_rect_t *d = &self->dirty[i];
+			if (r.x0 <= d->x1 + 1 && d->x0 <= r.x1 + 1 && r.y0 <= d->y1 + 1 && d->y0 <= r.y1 + 1) {
+				r.x0 = MIN(r.x0, d->x0);
+				r.y0 = MIN(r.y0, d->y0);
+				r.x1 = MAX(r.x1, d->x1);
+				r.y1 = MAX(r.y1, d->y1);
+				*d = self->dirty[--self->dirty_count];
+				merged = true;
+				break;
+			}
+		}
+		if (merged) {
+			continue;
+		}
 
-	for (; i < chunks; i++) {
-		write_spi(self->spi_obj, (const uint8_t *) buf_info.buf + i * buf_size, buf_size);
-	}
+		if (self->dirty_count < ILI9342C_DIRTY_RECTS) {
+			break;
+		}
 
-	if (rest) {
-		write_spi(self->spi_obj, (const uint8_t *) buf_info.buf + i * buf_size, rest);
+		// list is full, merge with the rectangle that grows the least
+		int best = 0;
+		uint32_t best_growth = UINT32_MAX;
+		for (int i = 0; i < self->dirty_count; i++) {
+			ili9342c_rect_t *d = &self->dirty[i];
+			uint32_t w = MAX(r.x1, d->x1) - MIN(r.x0, d->x0) + 1;
+			uint32_t h = MAX(r.y1, d->y1) - MIN(r.y0, d->y0) + 1;
+			uint32_t growth = w * h - (d->x1 - d->x0 + 1) * (d->y1 - d->y0 + 1);
+			if (growth < best_growth) {
+				best_growth = growth;
+				best = i;
+			}
+		}
+		ili9342c_rect_t *d = &self->dirty[best];
+		r.x0 = MIN(r.x0, d->x0);
+		r.y0 = MIN(r.y0, d->y0);
+		r.x1 = MAX(r.x1, d->x1);
+		r.y1 = MAX(r.y1, d->y1);
+		*d = self->dirty[--self->dirty_count];
 	}
-	CS_HIGH();
+	self->dirty[self->dirty_count++] = r;
+}
 
-	return mp_const_none;
+static void framebuffer_window(ili9342c_ILI9342C_obj_t *self, uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1) {
+	self->fb_window.x0 = x0;
+	self->fb_window.y0 = y0;
+	self->fb_window.x1 = x1;
+	self->fb_window.y1 = y1;
+	self->fb_window_valid = true;
+	self->fb_x = x0;
+	self->fb_y = y0;
 }
-static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_blit_buffer_obj, 6, 6, ili9342c_ILI9342C_blit_buffer);
 
+// number of pixels left on the current row of the window, wrapping to the
+// next row (and back to the top) like the display does when it is used up
+static int framebuffer_run(ili9342c_ILI9342C_obj_t *self) {
+	if (self->fb_x > self->fb_window.x1) {
+		self->fb_x = self->fb_window.x0;
+		if (++self->fb_y > self->fb_window.y1) {
+			self->fb_y = self->fb_window.y0;
+		}
+	}
+	return self->fb_window.x1 - self->fb_x + 1;
+}
 
-static mp_obj_t ili9342c_ILI9342C_draw(size_t n_args, const mp_obj_t *args) {
-	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
-	char		single_char_s[] = {0, 0};
-	const char *s;
+// rows outside fb_top to fb_bottom are not held in the buffer and are skipped
 
-	mp_obj_module_t *hershey   = MP_OBJ_TO_PTR(args[1]);
+static void framebuffer_write(ili9342c_ILI9342C_obj_t *self, const uint8_t *data, int len) {
+	if (!self->fb_window_valid) {
+		return;
+	}
 
-	if (mp_obj_is_int(args[2])) {
-		mp_int_t c		 = mp_obj_get_int(args[2]);
-		single_char_s[0] = c & 0xff;
-		s				 = single_char_s;
-	} else {
-		s= mp_obj_str_get_str(args[2]);
+	int pixels = len / 2;
+	while (pixels > 0) {
+		int run = MIN(pixels, framebuffer_run(self));
+		if (self->fb_y >= self->fb_top && self->fb_y <= self->fb_bottom) {
+			memcpy(self->frame_buffer + (self->fb_y - self->fb_top) * self->width + self->fb_x, data, run * 2);
+		}
+		data += run * 2;
+		pixels -= run;
+		self->fb_x += run;
 	}
+}
 
-	mp_int_t		 x		   = mp_obj_get_int(args[3]);
-	mp_int_t		 y		   = mp_obj_get_int(args[4]);
-	mp_int_t		 color     = mp_obj_get_int(args[5]);
+static void framebuffer_fill(ili9342c_ILI9342C_obj_t *self, uint16_t color_swapped, int pixels) {
+	if (!self->fb_window_valid) {
+		return;
+	}
 
-    mp_float_t scale = 1.0;
-    if (mp_obj_is_float(args[6])) {
-        scale = mp_obj_float_get(args[6]);
-    }
+	while (pixels > 0) {
+		int run = MIN(pixels, framebuffer_run(self));
+		if (self->fb_y >= self->fb_top && self->fb_y <= self->fb_bottom) {
+			uint16_t *dst = self->frame_buffer + (self->fb_y - self->fb_top) * self->width + self->fb_x;
+			for (int i = 0; i < run; i++) {
+				*dst++ = color_swapped;
+			}
+		}
+		pixels -= run;
+		self->fb_x += run;
+	}
+}
 
-    if (mp_obj_is_int(args[6])) {
-        scale =  (float) mp_obj_get_int(args[6]);
-    }
+// send a window to the display, skipping the column or page range if unchanged
+static void send_window(ili9342c_ILI9342C_obj_t *self, uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1) {
+	// only send the column and page ranges that changed since the last window
+	if (!self->window_valid || x0 != self->window_x0 || x1 != self->window_x1) {
+		uint8_t bufx[4] = {x0 >> 8, x0 & 0xFF, x1 >> 8, x1 & 0xFF};
+		write_cmd(self, ILI9342C_CASET, bufx, 4);
+		self->window_x0 = x0;
+		self->window_x1 = x1;
+	}
+	if (!self->window_valid || y0 != self->window_y0 || y1 != self->window_y1) {
+		uint8_t bufy[4] = {y0 >> 8, y0 & 0xFF, y1 >> 8, y1 & 0xFF};
+		write_cmd(self, ILI9342C_PASET, bufy, 4);
+		self->window_y0 = y0;
+		self->window_y1 = y1;
+	}
+	self->window_valid = true;
+	write_cmd(self, ILI9342C_RAMWR, NULL, 0);
+}
 
-	mp_obj_dict_t *	 dict	   = MP_OBJ_TO_PTR(hershey->globals);
-	mp_obj_t *		 index_data_buff = mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_INDEX));
-	mp_buffer_info_t index_bufinfo;
-	mp_get_buffer_raise(index_data_buff, &index_bufinfo, MP_BUFFER_READ);
-	uint8_t *index = index_bufinfo.buf;
+//
+// Band mode
+//
+// set_window() and the pixel writes are recorded into the display list
+// instead of being sent. show() then renders the display in bands of
+// band_rows rows into a buffer of its own, as the i2c_buffer may
+// hold the pixels being recorded when the list fills up. The
+// list is replayed into the band buffer with the framebuffer routines and
+// only the windows drawn in that band are sent from it. Bands no window
+// touches are skipped. When the list fills up it is shown and restarted.
+//
 
-	mp_obj_t *		 font_data_buff = mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_FONT));
-	mp_buffer_info_t font_bufinfo;
-	mp_get_buffer_raise(font_data_buff, &font_bufinfo, MP_BUFFER_READ);
-	int8_t *font = font_bufinfo.buf;
+#define DL_WINDOW	1				// followed by an ili9342c_rect_t
+#define DL_FILL		2				// len pixels of color
+#define DL_DATA		3				// followed by len pixels, padded to 4 bytes
+
+typedef struct _dl_record_t {
+	uint16_t op;
+	uint16_t color;					// DL_FILL color, byte swapped
+	uint32_t len;					// DL_WINDOW starting pixel, else pixels
+} dl_record_t;
+
+static void bands_show(ili9342c_ILI9342C_obj_t *self);
+
+// return space for a record of size bytes, showing the list first if full
+static dl_record_t *dl_alloc(ili9342c_ILI9342C_obj_t *self, uint32_t size) {
+	if (self->dl_len + size > self->dl_size) {
+		bands_show(self);
+
+		// carry on in the same window where the last list stopped
+		if (self->dl_window_valid) {
+			dl_record_t *rec = (dl_record_t *) self->display_list;
+			rec->op = DL_WINDOW;
+			rec->len = self->dl_offset;
+			memcpy(rec + 1, &self->dl_window, sizeof(ili9342c_rect_t));
+			self->dl_len = sizeof(dl_record_t) + sizeof(ili9342c_rect_t);
+		}
+	}
+	dl_record_t *rec = (dl_record_t *) (self->display_list + self->dl_len);
+	self->dl_len += size;
+	return rec;
+}
 
-    int16_t from_x = x;
-    int16_t from_y  = y;
-    int16_t to_x = x;
-    int16_t to_y = y;
-    int16_t pos_x = x;
-    int16_t pos_y = y;
-    bool penup = true;
-    char c;
-    int16_t ii;
+static void dl_window(ili9342c_ILI9342C_obj_t *self, uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1) {
+	ili9342c_rect_t r = {x0, y0, x1, y1};
 
-    while ((c = *s++)) {
-        if (c >= 32 && c <= 127) {
-            ii = (c-32) * 2;
+	self->dl_window = r;
+	self->dl_window_valid = false;		// nothing to carry on if the list fills here
+	self->dl_offset = 0;
 
-			int16_t offset = index[ii] | (index[ii+1] << 8);
-            int16_t length = font[offset++];
-            int16_t left = lround((font[offset++] - 0x52) * scale);
-            int16_t right = lround((font[offset++] - 0x52) * scale);
-            int16_t width = right - left;
+	dl_record_t *rec = dl_alloc(self, sizeof(dl_record_t) + sizeof(ili9342c_rect_t));
+	rec->op = DL_WINDOW;
+	rec->len = 0;
+	memcpy(rec + 1, &r, sizeof(ili9342c_rect_t));
+	self->dl_window_valid = true;
+}
 
-            if (length) {
-                int16_t i;
-                for (i = 0; i < length; i++) {
-                    if (font[offset] == ' ') {
-                        offset+=2;
-                        penup = true;
-                        continue;
-                    }
+static void dl_fill(ili9342c_ILI9342C_obj_t *self, uint16_t color_swapped, uint32_t pixels) {
+	if (!self->dl_window_valid || !pixels) {
+		return;
+	}
 
-                    int16_t vector_x = lround((font[offset++] - 0x52) * scale);
-                    int16_t vector_y = lround((font[offset++] - 0x52) * scale);
+	dl_record_t *rec = dl_alloc(self, sizeof(dl_record_t));
+	rec->op = DL_FILL;
+	rec->color = color_swapped;
+	rec->len = pixels;
+	self->dl_offset += pixels;
+}
 
-                    if (!i ||  penup) {
-                        from_x = pos_x + vector_x - left;
-                        from_y = pos_y + vector_y;
-                    } else {
-                        to_x = pos_x + vector_x - left;
-                        to_y = pos_y + vector_y;
+static void dl_write(ili9342c_ILI9342C_obj_t *self, const uint8_t *data, int len) {
+	uint32_t max_pixels = (self->dl_size - sizeof(dl_record_t) * 2 - sizeof(ili9342c_rect_t)) / 4 * 2;
+	uint32_t pixels = len / 2;
 
-                        line(self, from_x, from_y, to_x, to_y, color);
-                        from_x = to_x;
-                        from_y = to_y;
-                    }
-                    penup = false;
-                }
-            }
-			pos_x += width;
-        }
-    }
+	if (!self->dl_window_valid) {
+		return;
+	}
 
-	return mp_const_none;
+	// split writes too large for the list
+	while (pixels) {
+		uint32_t count = MIN(pixels, max_pixels);
+		dl_record_t *rec = dl_alloc(self, sizeof(dl_record_t) + ((count * 2 + 3) & ~3));
+		rec->op = DL_DATA;
+		rec->len = count;
+		memcpy(rec + 1, data, count * 2);
+		self->dl_offset += count;
+		data += count * 2;
+		pixels -= count;
+	}
 }
 
-static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_draw_obj, 6, 7, ili9342c_ILI9342C_draw);
+// add a window to the rectangles to send from a band, merging only where the
+// result is still exactly covered by drawn windows
+static int band_rect_add(ili9342c_rect_t *rects, int count, ili9342c_rect_t r) {
+	int i = 0;
+	while (i < count) {
+		ili9342c_rect_t *d = &rects[i];
+		if (r.x0 >= d->x0 && r.x1 <= d->x1 && r.y0 >= d->y0 && r.y1 <= d->y1) {
+			return count;
+		}
+		bool contains = (d->x0 >= r.x0 && d->x1 <= r.x1 && d->y0 >= r.y0 && d->y1 <= r.y1);
+		bool columns = (d->x0 == r.x0 && d->x1 == r.x1 && r.y0 <= d->y1 + 1 && d->y0 <= r.y1 + 1);
+		bool rows = (d->y0 == r.y0 && d->y1 == r.y1 && r.x0 <= d->x1 + 1 && d->x0 <= r.x1 + 1);
+		if (contains || columns || rows) {
+			r.x0 = MIN(r.x0, d->x0);
+			r.y0 = MIN(r.y0, d->y0);
+			r.x1 = MAX(r.x1, d->x1);
+			r.y1 = MAX(r.y1, d->y1);
+			*d = rects[--count];
+			i = 0;
+		} else {
+			i++;
+		}
+	}
+	rects[count++] = r;
+	return count;
+}
 
+static void band_send(ili9342c_ILI9342C_obj_t *self, uint16_t top, ili9342c_rect_t *rects, int count) {
+	for (int i = 0; i < count; i++) {
+		ili9342c_rect_t *r = &rects[i];
+		uint16_t w = r->x1 - r->x0 + 1;
 
-static uint32_t bs_bit		= 0;
-uint8_t * bitmap_data = NULL;
+		send_window(self, r->x0, r->y0, r->x1, r->y1);
+		if (w == self->width) {
+			queue_write(self, 1, (uint8_t *) (self->band + (r->y0 - top) * self->width), w * (r->y1 - r->y0 + 1) * 2);
+		} else {
+			for (uint16_t y = r->y0; y <= r->y1; y++) {
+				queue_write(self, 1, (uint8_t *) (self->band + (y - top) * self->width + r->x0), w * 2);
+			}
+		}
+	}
+}
 
-uint8_t get_color(uint8_t bpp) {
-	uint8_t color = 0;
-	int		i;
+// add the pixels start to end - 1 of window w, clipped to the band, as a
+// partial first row, the full rows and a partial last row
+static int band_range_add(ili9342c_ILI9342C_obj_t *self, ili9342c_rect_t *rects, int count, ili9342c_rect_t w, uint32_t start, uint32_t end, uint16_t top, uint16_t bottom) {
+	uint32_t		width = w.x1 - w.x0 + 1;
+	uint16_t		y0	  = w.y0 + start / width;
+	uint16_t		y1	  = w.y0 + (end - 1) / width;
+	uint16_t		x0	  = w.x0 + start % width;
+	uint16_t		x1	  = w.x0 + (end - 1) % width;
+	ili9342c_rect_t parts[3];
+	int				n = 0;
+
+	if (y0 == y1) {
+		parts[n++] = (ili9342c_rect_t) {x0, y0, x1, y0};
+	} else {
+		if (x0 != w.x0) {
+			parts[n++] = (ili9342c_rect_t) {x0, y0, w.x1, y0};
+			y0++;
+		}
+		if (x1 != w.x1) {
+			parts[n++] = (ili9342c_rect_t) {w.x0, y1, x1, y1};
+			y1--;
+		}
+		if (y0 <= y1) {
+			parts[n++] = (ili9342c_rect_t) {w.x0, y0, w.x1, y1};
+		}
+	}
 
-	for (i = 1; i < bpp; i++) {
-		color <<= 1;
-		color |= (bitmap_data[bs_bit / 8] & 1 << (7 - (bs_bit % 8))) > 0;
-		bs_bit++;
+	for (int i = 0; i < n; i++) {
+		if (parts[i].y0 <= bottom && parts[i].y1 >= top) {
+			parts[i].y0 = MAX(parts[i].y0, top);
+			parts[i].y1 = MIN(parts[i].y1, bottom);
+			if (count == ILI9342C_DIRTY_RECTS) {
+				band_send(self, top, rects, count);
+				count = 0;
+			}
+			count = band_rect_add(rects, count, parts[i]);
+		}
 	}
-	return color;
+	return count;
 }
 
+// add the pixels drawn in window w from pixel start, wrapping to the top of
+// the window like the display does
+static int band_window_add(ili9342c_ILI9342C_obj_t *self, ili9342c_rect_t *rects, int count, ili9342c_rect_t w, uint32_t start, uint32_t pixels, uint16_t top, uint16_t bottom) {
+	uint32_t size = (w.x1 - w.x0 + 1) * (w.y1 - w.y0 + 1);
 
-mp_obj_t dict_lookup(mp_obj_t self_in, mp_obj_t index) {
-    mp_obj_dict_t *self = MP_OBJ_TO_PTR(self_in);
-    mp_map_elem_t *elem = mp_map_lookup(&self->map, index, MP_MAP_LOOKUP);
-    if (elem == NULL) {
-        return NULL;
-    } else {
-        return elem->value;
-    }
+	start %= size;
+	if (pixels >= size) {
+		return band_range_add(self, rects, count, w, 0, size, top, bottom);
+	}
+	if (start + pixels > size) {
+		count = band_range_add(self, rects, count, w, start, size, top, bottom);
+		return band_range_add(self, rects, count, w, 0, start + pixels - size, top, bottom);
+	}
+	return band_range_add(self, rects, count, w, start, start + pixels, top, bottom);
 }
 
-static mp_obj_t ili9342c_ILI9342C_write_len(size_t n_args, const mp_obj_t *args) {
-	mp_obj_module_t *font = MP_OBJ_TO_PTR(args[1]);
-	char single_char_s[2] = {0, 0};
-	const char *str;
+static void bands_show(ili9342c_ILI9342C_obj_t *self) {
+	uint8_t *end = self->display_list + self->dl_len;
+	uint16_t *band = self->band;
+	uint16_t rows = self->band_rows;
 
-	if (mp_obj_is_int(args[2])) {
-		mp_int_t c = mp_obj_get_int(args[2]);
-		single_char_s[0] = c & 0xff;
-		str	= single_char_s;
-	} else {
-		str = mp_obj_str_get_str(args[2]);
+	if (self->dl_len == 0) {
+		return;
 	}
 
-	mp_obj_dict_t *dict	= MP_OBJ_TO_PTR(font->globals);
-	const char 	  *map  = mp_obj_str_get_str(mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_MAP)));
-
-	mp_obj_t widths_data_buff = mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_WIDTHS));
-	mp_buffer_info_t widths_bufinfo;
-	mp_get_buffer_raise(widths_data_buff, &widths_bufinfo, MP_BUFFER_READ);
-	const uint8_t *widths_data = widths_bufinfo.buf;
+	for (uint16_t top = 0; top < self->height; top += rows) {
+		uint16_t bottom = MIN(top + rows - 1, self->height - 1);
+		ili9342c_rect_t rects[ILI9342C_DIRTY_RECTS];
+		int count = 0;
+		bool touched = false;
+		uint8_t *p;
+
+		for (p = self->display_list; p < end && !touched;) {
+			dl_record_t *rec = (dl_record_t *) p;
+			if (rec->op == DL_WINDOW) {
+				ili9342c_rect_t *r = (ili9342c_rect_t *) (rec + 1);
+				touched = (r->y0 <= bottom && r->y1 >= top);
+				p += sizeof(dl_record_t) + sizeof(ili9342c_rect_t);
+			} else if (rec->op == DL_FILL) {
+				p += sizeof(dl_record_t);
+			} else {
+				p += sizeof(dl_record_t) + ((rec->len * 2 + 3) & ~3);
+			}
+		}
+		if (!touched) {
+			continue;
+		}
 
-	uint16_t print_width = 0;
-	uint8_t chr;
+		// replay the list into the band
+		self->frame_buffer = band;
+		self->fb_top = top;
+		self->fb_bottom = bottom;
+		self->fb_window_valid = false;
+		for (p = self->display_list; p < end;) {
+			dl_record_t *rec = (dl_record_t *) p;
+			if (rec->op == DL_WINDOW) {
+				ili9342c_rect_t *r = (ili9342c_rect_t *) (rec + 1);
+				uint16_t w = r->x1 - r->x0 + 1;
+				uint16_t h = r->y1 - r->y0 + 1;
+				framebuffer_window(self, r->x0, r->y0, r->x1, r->y1);
+				self->fb_x = r->x0 + rec->len % w;
+				self->fb_y = r->y0 + (rec->len / w) % h;
+				// windows outside the band are skipped along with their pixels
+				self->fb_window_valid = (r->y0 <= bottom && r->y1 >= top);
+				p += sizeof(dl_record_t) + sizeof(ili9342c_rect_t);
+			} else if (rec->op == DL_FILL) {
+				framebuffer_fill(self, rec->color, rec->len);
+				p += sizeof(dl_record_t);
+			} else {
+				framebuffer_write(self, (uint8_t *) (rec + 1), rec->len * 2);
+				p += sizeof(dl_record_t) + ((rec->len * 2 + 3) & ~3);
+			}
+		}
+		self->frame_buffer = NULL;
+
+		// send the pixels drawn in each window that fall in the band
+		ili9342c_rect_t window = {0, 0, 0, 0};
+		uint32_t start = 0, pixels = 0;
+		for (p = self->display_list; p <= end;) {
+			dl_record_t *rec = (dl_record_t *) p;
+			if (p == end || rec->op == DL_WINDOW) {
+				if (pixels) {
+					count = band_window_add(self, rects, count, window, start, pixels, top, bottom);
+				}
+				if (p == end) {
+					break;
+				}
+				window = *(ili9342c_rect_t *) (rec + 1);
+				start = rec->len;
+				pixels = 0;
+				p += sizeof(dl_record_t) + sizeof(ili9342c_rect_t);
+			} else if (rec->op == DL_FILL) {
+				pixels += rec->len;
+				p += sizeof(dl_record_t);
+			} else {
+				pixels += rec->len;
+				p += sizeof(dl_record_t) + ((rec->len * 2 + 3) & ~3);
+			}
+		}
+		band_send(self, top, rects, count);
+	}
 
-	while ((chr = *str++)) {
-		char *char_pointer = strchr(map, chr);
-		if (char_pointer) {
-			uint16_t char_index = char_pointer - map;
-			print_width += widths_data[char_index];
-        }
-    }
-	return mp_obj_new_int(print_width);
+	self->dl_len = 0;
+	queue_flush(self);
 }
 
-static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_write_len_obj, 3, 3, ili9342c_ILI9342C_write_len);
+static void write_data(ili9342c_ILI9342C_obj_t *self, const uint8_t *data, int len) {
+	if (self->display_list) {
+		dl_write(self, data, len);
+		return;
+	}
+	if (self->frame_buffer) {
+		framebuffer_write(self, data, len);
+		return;
+	}
+	queue_write(self, 1, data, len);
+}
 
+static void set_window(ili9342c_ILI9342C_obj_t *self, uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1) {
+	if (x0 > x1 || x1 >= self->width) {
+		self->fb_window_valid = false;
+		self->dl_window_valid = false;
+		return;
+	}
+	if (y0 > y1 || y1 >= self->height) {
+		self->fb_window_valid = false;
+		self->dl_window_valid = false;
+		return;
+	}
 
-//
-//	write(font_module, s, x, y[, fg, bg])
-//
+	if (self->display_list) {
+		dl_window(self, x0, y0, x1, y1);
+	} else if (self->frame_buffer) {
+		framebuffer_window(self, x0, y0, x1, y1);
+		dirty_add(self, x0, y0, x1, y1);
+	} else {
+		send_window(self, x0, y0, x1, y1);
+	}
+}
 
-static mp_obj_t ili9342c_ILI9342C_write(size_t n_args, const mp_obj_t *args) {
-	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
-	mp_obj_module_t *font = MP_OBJ_TO_PTR(args[1]);
+// forget the cached window after anything that may have changed it behind set_window()
+static void window_invalidate(ili9342c_ILI9342C_obj_t *self) {
+	self->window_valid = false;
+}
 
-	char single_char_s[2] = {0, 0};
-	const char *str;
+static void fill_color_buffer(ili9342c_ILI9342C_obj_t *self, uint16_t color, int length) {
+	uint16_t color_swapped = _swap_bytes(color);
 
-	if (mp_obj_is_int(args[2])) {
-		mp_int_t c = mp_obj_get_int(args[2]);
-		single_char_s[0] = c & 0xff;
-		str	= single_char_s;
-	} else {
-		str = mp_obj_str_get_str(args[2]);
+	if (self->display_list) {
+		dl_fill(self, color_swapped, length);
+		return;
+	}
+	if (self->frame_buffer) {
+		framebuffer_fill(self, color_swapped, length);
+		return;
 	}
 
-	mp_int_t x = mp_obj_get_int(args[3]);
-	mp_int_t y = mp_obj_get_int(args[4]);
-	mp_int_t fg_color;
-	mp_int_t bg_color;
+	if (self->fill_buffer == NULL) {
+		self->fill_buffer = m_malloc(self->fill_size * 2);
+		self->fill_count = 0;
+	}
 
-	fg_color = (n_args > 5) ? _swap_bytes(mp_obj_get_int(args[5])) : _swap_bytes(WHITE);
-	bg_color = (n_args > 6) ? _swap_bytes(mp_obj_get_int(args[6])) : _swap_bytes(BLACK);
+	// the pattern is kept between fills and only extended as needed
+	uint32_t needed = MIN((uint32_t) length, self->fill_size);
+	if (self->fill_color != color_swapped) {
+		self->fill_color = color_swapped;
+		self->fill_count = 0;
+	}
+	for (; self->fill_count < needed; self->fill_count++) {
+		self->fill_buffer[self->fill_count] = color_swapped;
+	}
 
-	mp_obj_dict_t *dict			  = MP_OBJ_TO_PTR(font->globals);
-	const char 	  *map 			  = mp_obj_str_get_str(mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_MAP)));
-	const uint8_t  bpp			  = mp_obj_get_int(mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_BPP)));
-	const uint8_t  height		  = mp_obj_get_int(mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_HEIGHT)));
-	const uint8_t  offset_width	  = mp_obj_get_int(mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_OFFSET_WIDTH)));
-	const uint8_t  max_width	  = mp_obj_get_int(mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_MAX_WIDTH)));
+	while (length > 0) {
+		int pixels = MIN((uint32_t) length, self->fill_size);
+		write_data(self, (uint8_t *) self->fill_buffer, pixels * 2);
+		length -= pixels;
+	}
+}
 
-	mp_obj_t widths_data_buff = mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_WIDTHS));
-	mp_buffer_info_t widths_bufinfo;
-	mp_get_buffer_raise(widths_data_buff, &widths_bufinfo, MP_BUFFER_READ);
-	const uint8_t *widths_data = widths_bufinfo.buf;
+static void draw_pixel(ili9342c_ILI9342C_obj_t *self, uint16_t x, uint16_t y, uint16_t color) {
+	uint8_t buf[2] = {color >> 8, color & 0xFF};
+	set_window(self, x, y, x, y);
+	write_data(self, buf, 2);
+}
 
-	mp_obj_t offsets_data_buff = mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_OFFSETS));
-	mp_buffer_info_t offsets_bufinfo;
-	mp_get_buffer_raise(offsets_data_buff, &offsets_bufinfo, MP_BUFFER_READ);
-	const uint8_t *offsets_data = offsets_bufinfo.buf;
+static void fast_hline(ili9342c_ILI9342C_obj_t *self, uint16_t x, uint16_t y, uint16_t _w, uint16_t color) {
+	int w;
 
-	mp_obj_t bitmaps_data_buff = mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_BITMAPS));
-	mp_buffer_info_t bitmaps_bufinfo;
-	mp_get_buffer_raise(bitmaps_data_buff, &bitmaps_bufinfo, MP_BUFFER_READ);
-	bitmap_data = bitmaps_bufinfo.buf;
+	if (x + _w > self->width)
+		w = self->width - x;
+	else
+		w = _w;
 
-	uint32_t buf_size = max_width * height * 2;
-	if (self->buffer_size == 0) {
-		self->i2c_buffer = m_malloc(buf_size);
+	if (w > 0) {
+		set_window(self, x, y, x + w - 1, y);
+		fill_color_buffer(self, color, w);
 	}
+}
 
-	uint16_t print_width = 0;
-	uint8_t chr;
-
-	while ((chr = *str++)) {
-		char *char_pointer = strchr(map, chr);
-		if (char_pointer) {
-			uint16_t char_index = char_pointer - map;
-			uint8_t width = widths_data[char_index];
-
-			bs_bit = 0;
-			switch (offset_width) {
-				case 1:
-					bs_bit = offsets_data[char_index * offset_width];
-					break;
+static void fast_vline(ili9342c_ILI9342C_obj_t *self, uint16_t x, uint16_t y, uint16_t w, uint16_t color) {
+	set_window(self, x, y, x, y + w - 1);
+	fill_color_buffer(self, color, w);
+}
 
-				case 2:
-					bs_bit = (offsets_data[char_index * offset_width] << 8) +
-                			 (offsets_data[char_index * offset_width + 1]);
-					break;
+// send the dirty rectangles of the frame buffer to the display
+static void framebuffer_show(ili9342c_ILI9342C_obj_t *self) {
+	for (int i = 0; i < self->dirty_count; i++) {
+		ili9342c_rect_t *r = &self->dirty[i];
+		uint16_t w = r->x1 - r->x0 + 1;
 
-				case 3:
-					bs_bit = (offsets_data[char_index * offset_width] << 16) +
-                		     (offsets_data[char_index * offset_width + 1] << 8) +
-                		     (offsets_data[char_index * offset_width + 2]);
-					break;
+		send_window(self, r->x0, r->y0, r->x1, r->y1);
+		if (w == self->width) {
+			queue_write(self, 1, (uint8_t *) (self->frame_buffer + r->y0 * self->width), w * (r->y1 - r->y0 + 1) * 2);
+		} else {
+			for (uint16_t y = r->y0; y <= r->y1; y++) {
+				queue_write(self, 1, (uint8_t *) (self->frame_buffer + y * self->width + r->x0), w * 2);
 			}
+		}
+	}
+	self->dirty_count = 0;
+	queue_flush(self);
+}
 
-			uint32_t ofs = 0;
-			for (int yy = 0; yy < height; yy++) {
-				for (int xx = 0; xx < width; xx++) {
-					self->i2c_buffer[ofs++] = get_color(bpp + 1) ? fg_color : bg_color;
+static void show(ili9342c_ILI9342C_obj_t *self) {
+	if (self->display_list) {
+		bands_show(self);
+	} else if (self->frame_buffer) {
+		framebuffer_show(self);
+	}
+}
+
+static mp_obj_t ili9342c_ILI9342C_show(mp_obj_t self_in) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(self_in);
+
+	show(self);
+	return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_1(ili9342c_ILI9342C_show_obj, ili9342c_ILI9342C_show);
+
+static mp_obj_t ili9342c_ILI9342C_hard_reset(mp_obj_t self_in) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(self_in);
+
+	window_invalidate(self);
+	async_wait(self);
+	queue_flush(self);
+	bus_acquire(self);
+	CS_LOW();
+	RESET_HIGH();
+	mp_hal_delay_ms(50);
+	RESET_LOW();
+	mp_hal_delay_ms(50);
+	RESET_HIGH();
+	mp_hal_delay_ms(150);
+	CS_HIGH();
+	bus_release(self);
+	return mp_const_none;
+}
+
+static mp_obj_t ili9342c_ILI9342C_soft_reset(mp_obj_t self_in) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(self_in);
+
+	write_cmd(self, ILI9342C_SWRESET, NULL, 0);
+	queue_flush(self);
+	window_invalidate(self);
+	mp_hal_delay_ms(150);
+	return mp_const_none;
+}
+
+/*
+static mp_obj_t ili9342c_ILI9342C_write(mp_obj_t self_in, mp_obj_t command, mp_obj_t data) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(self_in);
+	mp_buffer_info_t		 src;
+
+	window_invalidate(self);
+	if (data == mp_const_none) {
+		write_cmd(self, (uint8_t) mp_obj_get_int(command), NULL, 0);
+	} else {
+		mp_get_buffer_raise(data, &src, MP_BUFFER_READ);
+		write_cmd(self, (uint8_t) mp_obj_get_int(command), (const uint8_t *) src.buf, src.len);
+	}
+	return mp_const_none;
+}
+
+MP_DEFINE_CONST_FUN_OBJ_3(ili9342c_ILI9342C_write_obj, ili9342c_ILI9342C_write);
+*/
+
+MP_DEFINE_CONST_FUN_OBJ_1(ili9342c_ILI9342C_hard_reset_obj, ili9342c_ILI9342C_hard_reset);
+MP_DEFINE_CONST_FUN_OBJ_1(ili9342c_ILI9342C_soft_reset_obj, ili9342c_ILI9342C_soft_reset);
+
+static mp_obj_t ili9342c_ILI9342C_sleep_mode(mp_obj_t self_in, mp_obj_t value) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(self_in);
+	if (mp_obj_is_true(value)) {
+		write_cmd(self, ILI9342C_SLPIN, NULL, 0);
+	} else {
+		write_cmd(self, ILI9342C_SLPOUT, NULL, 0);
+	}
+	queue_flush(self);
+	return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_2(ili9342c_ILI9342C_sleep_mode_obj, ili9342c_ILI9342C_sleep_mode);
+
+static mp_obj_t ili9342c_ILI9342C_set_window(size_t n_args, const mp_obj_t *args) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+
+	mp_int_t x0 = mp_obj_get_int(args[1]);
+	mp_int_t x1 = mp_obj_get_int(args[2]);
+	mp_int_t y0 = mp_obj_get_int(args[3]);
+	mp_int_t y1 = mp_obj_get_int(args[4]);
+
+	set_window(self, x0, y0, x1, y1);
+	queue_flush(self);
+	return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_set_window_obj, 5, 5, ili9342c_ILI9342C_set_window);
+static mp_obj_t ili9342c_ILI9342C_inversion_mode(mp_obj_t self_in, mp_obj_t value) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(self_in);
+
+	if (mp_obj_is_true(value)) {
+		write_cmd(self, ILI9342C_INVON, NULL, 0);
+	} else {
+		write_cmd(self, ILI9342C_INVOFF, NULL, 0);
+	}
+	queue_flush(self);
+	return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_2(ili9342c_ILI9342C_inversion_mode_obj, ili9342c_ILI9342C_inversion_mode);
+
+static mp_obj_t ili9342c_ILI9342C_fill_rect(size_t n_args, const mp_obj_t *args) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+
+	mp_int_t x	   = mp_obj_get_int(args[1]);
+	mp_int_t y	   = mp_obj_get_int(args[2]);
+	mp_int_t w	   = mp_obj_get_int(args[3]);
+	mp_int_t h	   = mp_obj_get_int(args[4]);
+	mp_int_t color = mp_obj_get_int(args[5]);
+
+	set_window(self, x, y, x + w - 1, y + h - 1);
+	fill_color_buffer(self, color, w * h);
+	queue_flush(self);
+
+	return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_fill_rect_obj, 6, 6, ili9342c_ILI9342C_fill_rect);
+
+static mp_obj_t ili9342c_ILI9342C_fill(mp_obj_t self_in, mp_obj_t _color) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(self_in);
+
+	mp_int_t color = mp_obj_get_int(_color);
+
+	set_window(self, 0, 0, self->width - 1, self->height - 1);
+	fill_color_buffer(self, color, self->width * self->height);
+	queue_flush(self);
+
+	return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_2(ili9342c_ILI9342C_fill_obj, ili9342c_ILI9342C_fill);
+
+static mp_obj_t ili9342c_ILI9342C_pixel(size_t n_args, const mp_obj_t *args) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+
+	mp_int_t x	   = mp_obj_get_int(args[1]);
+	mp_int_t y	   = mp_obj_get_int(args[2]);
+	mp_int_t color = mp_obj_get_int(args[3]);
+
+	draw_pixel(self, x, y, color);
+	queue_flush(self);
+
+	return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_pixel_obj, 4, 4, ili9342c_ILI9342C_pixel);
+
+//
+// Lines
+//
+// Each line is clipped to the display before it is drawn, so only its
+// visible part is stepped through. Its runs of pixels go
+// to a span batcher, which merges a run into the one before it when they are
+// in the same row or column and touch, as the joints of a polyline and the
+// steps of a trace along an axis do, or grows it into a rectangle when the
+// run is the same span of the next row, as the rows of a fill often are,
+// then sends each span as one window.
+//
+
+#define CLIP_LEFT	1				// Cohen-Sutherland clip codes
+#define CLIP_RIGHT	2
+#define CLIP_TOP	4
+#define CLIP_BOTTOM 8
+
+typedef struct {
+	ili9342c_ILI9342C_obj_t *self;
+	uint16_t color;
+	int16_t x0, y0, x1, y1;			// pending span, x0 > x1 when there is none
+	int16_t *left, *right;			// extents of each display row of a filled shape, or NULL
+} spans_t;
+
+static void spans_init(spans_t *spans, ili9342c_ILI9342C_obj_t *self, uint16_t color) {
+	spans->self	 = self;
+	spans->color = color;
+	spans->x0	 = 1;
+	spans->x1	 = 0;
+	spans->left	 = NULL;
+	spans->right = NULL;
+}
+
+// draw the pending span
+static void spans_flush(spans_t *spans) {
+	if (spans->x0 > spans->x1) {
+		return;
+	}
+	if (spans->x0 == spans->x1 && spans->y0 == spans->y1) {
+		draw_pixel(spans->self, spans->x0, spans->y0, spans->color);
+	} else {
+		set_window(spans->self, spans->x0, spans->y0, spans->x1, spans->y1);
+		fill_color_buffer(spans->self, spans->color, (spans->x1 - spans->x0 + 1) * (spans->y1 - spans->y0 + 1));
+	}
+	spans->x0 = 1;
+	spans->x1 = 0;
+}
+
+// add the run x0, y0 to x1, y1 of a row or column, x0 <= x1 and y0 <= y1
+static void spans_add(spans_t *spans, int16_t x0, int16_t y0, int16_t x1, int16_t y1) {
+	if (spans->x0 <= spans->x1) {
+		if (x0 == x1 && spans->x0 == x0 && spans->x1 == x0 && y0 <= spans->y1 + 1 && y1 + 1 >= spans->y0) {
+			spans->y0 = MIN(spans->y0, y0);
+			spans->y1 = MAX(spans->y1, y1);
+			return;
+		}
+		if (y0 == y1 && spans->y0 == y0 && spans->y1 == y0 && x0 <= spans->x1 + 1 && x1 + 1 >= spans->x0) {
+			spans->x0 = MIN(spans->x0, x0);
+			spans->x1 = MAX(spans->x1, x1);
+			return;
+		}
+		if (y0 == y1 && spans->x0 == x0 && spans->x1 == x1 && y0 == spans->y1 + 1) {
+			spans->y1 = y0;
+			return;
+		}
+		spans_flush(spans);
+	}
+	spans->x0 = x0;
+	spans->y0 = y0;
+	spans->x1 = x1;
+	spans->y1 = y1;
+}
+
+static int clip_code(ili9342c_ILI9342C_obj_t *self, int64_t x, int64_t y) {
+	return ((x < 0) ? CLIP_LEFT : (x >= self->width) ? CLIP_RIGHT : 0) |
+		   ((y < 0) ? CLIP_TOP : (y >= self->height) ? CLIP_BOTTOM : 0);
+}
+
+// add the runs of the part of a line on the display to spans. Lines with
+// both ends beyond the same edge are rejected by their clip codes, and the
+// steps of a line crossing an edge are limited to those on the display with
+// the stepping started part way along, so the pixels drawn are exactly those
+// of the whole line.
+static void spans_line(spans_t *spans, int64_t x0, int64_t y0, int64_t x1, int64_t y1) {
+	ili9342c_ILI9342C_obj_t *self = spans->self;
+	int c0 = clip_code(self, x0, y0);
+	int c1 = clip_code(self, x1, y1);
+	int64_t x_max = self->width - 1, y_max = self->height - 1;
+
+	if (c0 & c1) {
+		return;
+	}
+
+	bool steep = ABS(y1 - y0) > ABS(x1 - x0);
+	if (steep) {
+		_swap_int64_t(x0, y0);
+		_swap_int64_t(x1, y1);
+		_swap_int64_t(x_max, y_max);
+	}
+
+	if (x0 > x1) {
+		_swap_int64_t(x0, x1);
+		_swap_int64_t(y0, y1);
+	}
+
+	int64_t dx = x1 - x0, dy = ABS(y1 - y0);
+	int64_t ystep = (y0 < y1) ? 1 : -1;
+	int64_t e0 = dx >> 1;
+
+	// step k draws x0 + k, y0 + ystep * m, where m is the number of times the
+	// error term has wrapped, the least m with e0 - k * dy + m * dx >= 0
+	int64_t first = 0, last = dx;
+	if (c0 | c1) {
+		int64_t m_lo = (ystep > 0) ? -y0 : y0 - y_max;
+		int64_t m_hi = (ystep > 0) ? y_max - y0 : y0;
+
+		first = MAX(first, -x0);
+		last  = MIN(last, x_max - x0);
+		if (m_hi < 0) {
+			return;
+		}
+		if (dy) {
+			if (m_lo > 0) {
+				first = MAX(first, ((m_lo - 1) * dx + e0) / dy + 1);
+			}
+			last = MIN(last, (m_hi * dx + e0) / dy);
+		} else if (m_lo > 0) {
+			return;
+		}
+		if (first > last) {
+			return;
+		}
+	}
+
+	int64_t wraps = (dx && first * dy > e0) ? (first * dy - e0 + dx - 1) / dx : 0;
+	int64_t err	  = e0 - first * dy + wraps * dx;
+	int16_t x	  = x0 + first, y = y0 + ystep * wraps;
+	int16_t xs	  = x, xe = x0 + last;
+
+	// a run ends each time the minor axis steps
+	for (; x <= xe; x++) {
+		err -= dy;
+		if (err < 0 || x == xe) {
+			if (steep)
+				spans_add(spans, y, xs, y, x);
+			else
+				spans_add(spans, xs, y, x, y);
+			if (err < 0) {
+				err += dx;
+				y += ystep;
+			}
+			xs = x + 1;
+		}
+	}
+}
+
+static void line(ili9342c_ILI9342C_obj_t *self, mp_int_t x0, mp_int_t y0, mp_int_t x1, mp_int_t y1, uint16_t color) {
+	spans_t spans;
+
+	spans_init(&spans, self, color);
+	spans_line(&spans, x0, y0, x1, y1);
+	spans_flush(&spans);
+}
+
+//
+// Anti-aliased lines
+//
+// Wu's algorithm steps along the axis a line changes most on and splits each
+// step between the two pixels nearest the line on the other axis, weighted by
+// how near each is. The pixels are blended with a background color given, or
+// with those in the framebuffer. A line is drawn a pair of pixels at a time,
+// each pair as one window, or its coverage is recorded in a buffer of a box
+// to be blended and sent at once, as draw() does for each glyph.
+//
+
+typedef struct {
+	ili9342c_ILI9342C_obj_t *self;
+	uint16_t color;
+	uint16_t background;
+	bool sample;					// blend with the framebuffer's pixels instead of background
+	int16_t x0, y0, x1, y1;			// box drawn in, the display or the coverage buffer's
+	uint16_t *coverage;				// coverage 0 to 255 of each pixel of the box, or NULL to draw
+} aa_t;
+
+// an anti-aliased drawing in color over the background given by background_in,
+// a color or True for the framebuffer's pixels
+static void aa_init(aa_t *aa, ili9342c_ILI9342C_obj_t *self, uint16_t color, mp_obj_t background_in) {
+	aa->self	   = self;
+	aa->color	   = color;
+	aa->sample	   = (background_in == mp_const_true);
+	aa->background = (aa->sample) ? 0 : mp_obj_get_int(background_in);
+	aa->x0		   = 0;
+	aa->y0		   = 0;
+	aa->x1		   = self->width - 1;
+	aa->y1		   = self->height - 1;
+	aa->coverage   = NULL;
+	if (aa->sample && !self->frame_buffer) {
+		mp_raise_ValueError(MP_ERROR_TEXT("background=True needs framebuffer mode"));
+	}
+}
+
+// fg over bg with alpha 0 to 255, the channels blended in one multiply
+static uint16_t blend565(uint16_t fg, uint16_t bg, uint8_t alpha) {
+	uint32_t a = (alpha + 4) >> 3;
+	uint32_t f = (fg | (fg << 16)) & 0x07E0F81F;
+	uint32_t b = (bg | (bg << 16)) & 0x07E0F81F;
+	uint32_t c = ((((f - b) * a) >> 5) + b) & 0x07E0F81F;
+	return c | (c >> 16);
+}
+
+// the color of the pixel x, y with coverage alpha
+static uint16_t aa_pixel(const aa_t *aa, int16_t x, int16_t y, uint8_t alpha) {
+	ili9342c_ILI9342C_obj_t *self = aa->self;
+	uint16_t bg = aa->background;
+
+	if (aa->sample) {
+		bg = _swap_bytes(self->frame_buffer[(y - self->fb_top) * self->width + x]);
+	}
+	return blend565(aa->color, bg, alpha);
+}
+
+// add the pixels x, y with coverage alpha0 and the next one along the minor
+// axis with alpha1, skipping those outside the box
+static void aa_pair(aa_t *aa, bool steep, int64_t major, int64_t minor, uint8_t alpha0, uint8_t alpha1) {
+	int64_t x = (steep) ? minor : major, y = (steep) ? major : minor;
+	int64_t dx = (steep) ? 1 : 0, dy = (steep) ? 0 : 1;
+	bool in0 = x >= aa->x0 && x <= aa->x1 && y >= aa->y0 && y <= aa->y1 && alpha0;
+	bool in1 = x + dx <= aa->x1 && y + dy <= aa->y1 && x + dx >= aa->x0 && y + dy >= aa->y0 && alpha1;
+
+	if (aa->coverage) {
+		uint16_t w = aa->x1 - aa->x0 + 1;
+		if (in0) {
+			uint16_t *c = &aa->coverage[(y - aa->y0) * w + x - aa->x0];
+			*c = MAX(*c, alpha0);
+		}
+		if (in1) {
+			uint16_t *c = &aa->coverage[(y + dy - aa->y0) * w + x + dx - aa->x0];
+			*c = MAX(*c, alpha1);
+		}
+		return;
+	}
+
+	if (in0 && in1) {
+		uint16_t c0 = aa_pixel(aa, x, y, alpha0), c1 = aa_pixel(aa, x + dx, y + dy, alpha1);
+		uint8_t buf[4] = {c0 >> 8, c0 & 0xFF, c1 >> 8, c1 & 0xFF};
+		set_window(aa->self, x, y, x + dx, y + dy);
+		write_data(aa->self, buf, 4);
+	} else if (in0) {
+		draw_pixel(aa->self, x, y, aa_pixel(aa, x, y, alpha0));
+	} else if (in1) {
+		draw_pixel(aa->self, x + dx, y + dy, aa_pixel(aa, x + dx, y + dy, alpha1));
+	}
+}
+
+// add the anti-aliased line x0, y0 to x1, y1, stepping only along the part of
+// its major axis in the box. The minor axis position is kept in 16.16 fixed
+// point as a quotient and remainder, so the line ends exactly on x1, y1.
+static void aa_line(aa_t *aa, int64_t x0, int64_t y0, int64_t x1, int64_t y1) {
+	bool steep = ABS(y1 - y0) > ABS(x1 - x0);
+	int64_t major0 = aa->x0, major1 = aa->x1, minor0 = aa->y0, minor1 = aa->y1;
+
+	if (steep) {
+		_swap_int64_t(x0, y0);
+		_swap_int64_t(x1, y1);
+		_swap_int64_t(major0, minor0);
+		_swap_int64_t(major1, minor1);
+	}
+	if (x0 > x1) {
+		_swap_int64_t(x0, x1);
+		_swap_int64_t(y0, y1);
+	}
+	if (x1 < major0 || x0 > major1 || MAX(y0, y1) + 1 < minor0 || MIN(y0, y1) > minor1) {
+		return;
+	}
+
+	int64_t dx = x1 - x0, dy = ABS(y1 - y0);
+	int64_t ystep = (y0 < y1) ? 1 : -1;
+	int64_t first = MAX(0, major0 - x0), last = MIN(dx, major1 - x0);
+
+	if (dx == 0) {
+		aa_pair(aa, steep, x0, y0, 255, 0);
+		return;
+	}
+
+	int64_t q = (dy << 16) / dx, r = (dy << 16) % dx;
+	int64_t acc, rem = 0;
+	if (first * dy < (1LL << 46)) {
+		acc = ((first * dy) << 16) / dx;
+		rem = ((first * dy) << 16) % dx;
+	} else {
+		acc = (int64_t) ((double) first * dy * 65536.0 / dx);
+	}
+
+	for (int64_t k = first; k <= last; k++) {
+		int64_t pos = y0 * 65536 + ystep * acc;
+		uint8_t frac = (pos >> 8) & 0xFF;
+		aa_pair(aa, steep, x0 + k, pos >> 16, 255 - frac, frac);
+		acc += q;
+		rem += r;
+		if (rem >= dx) {
+			rem -= dx;
+			acc++;
+		}
+	}
+}
+
+//
+//	line(x0, y0, x1, y1, color[, background]) draws a line, anti-aliased over
+//	background when it is given, a color or True for the framebuffer's pixels
+//
+
+static mp_obj_t ili9342c_ILI9342C_line(size_t n_args, const mp_obj_t *args) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+
+	mp_int_t x0	   = mp_obj_get_int(args[1]);
+	mp_int_t y0	   = mp_obj_get_int(args[2]);
+	mp_int_t x1	   = mp_obj_get_int(args[3]);
+	mp_int_t y1	   = mp_obj_get_int(args[4]);
+	mp_int_t color = mp_obj_get_int(args[5]);
+
+	if (n_args > 6 && args[6] != mp_const_none) {
+		aa_t aa;
+		aa_init(&aa, self, color, args[6]);
+		aa_line(&aa, x0, y0, x1, y1);
+	} else {
+		line(self, x0, y0, x1, y1, color);
+	}
+	queue_flush(self);
+
+	return mp_const_none;
+}
+
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_line_obj, 6, 7, ili9342c_ILI9342C_line);
+
+// the size of a coordinate in an array of points, 0 if its type can not be used
+static size_t point_size(char typecode) {
+	switch (typecode) {
+		case 'b':
+		case 'B':
+			return 1;
+		case 'h':
+		case 'H':
+			return 2;
+		case 'i':
+		case 'I':
+			return 4;
+	}
+	return 0;
+}
+
+// coordinate i of an array of points
+static mp_int_t point_get(const mp_buffer_info_t *points, size_t i) {
+	switch (points->typecode) {
+		case 'b':
+			return ((const int8_t *) points->buf)[i];
+		case 'B':
+			return ((const uint8_t *) points->buf)[i];
+		case 'h':
+			return ((const int16_t *) points->buf)[i];
+		case 'H':
+			return ((const uint16_t *) points->buf)[i];
+		case 'i':
+			return ((const int32_t *) points->buf)[i];
+	}
+	return ((const uint32_t *) points->buf)[i];
+}
+
+// the points of a flat list or tuple of coordinates x0, y0, x1, y1, ..., or
+// of an array of them
+typedef struct {
+	mp_obj_t *items;				// the list or tuple's coordinates, NULL for an array
+	mp_buffer_info_t buf;			// the array's coordinates
+	size_t count;					// number of points
+} points_t;
+
+static void points_init(points_t *points, mp_obj_t points_in) {
+	size_t count;
+
+	points->items = NULL;
+	if (mp_obj_is_type(points_in, &mp_type_list) || mp_obj_is_type(points_in, &mp_type_tuple)) {
+		mp_obj_get_array(points_in, &count, &points->items);
+	} else {
+		mp_get_buffer_raise(points_in, &points->buf, MP_BUFFER_READ);
+		if (point_size(points->buf.typecode) == 0) {
+			mp_raise_TypeError(MP_ERROR_TEXT("points array must be of 8, 16 or 32 bit ints"));
+		}
+		count = points->buf.len / point_size(points->buf.typecode);
+	}
+	if (count & 1) {
+		mp_raise_ValueError(MP_ERROR_TEXT("points must be x, y pairs"));
+	}
+	points->count = count / 2;
+}
+
+// point i of points
+static void points_get(const points_t *points, size_t i, mp_int_t *x, mp_int_t *y) {
+	if (points->items) {
+		*x = mp_obj_get_int(points->items[2 * i]);
+		*y = mp_obj_get_int(points->items[2 * i + 1]);
+	} else {
+		*x = point_get(&points->buf, 2 * i);
+		*y = point_get(&points->buf, 2 * i + 1);
+	}
+}
+
+//
+//	polyline(points, color) draws lines joining the points x0, y0, x1, y1, ...
+//	given as a flat list or tuple of coordinates, or an array of them
+//
+
+static mp_obj_t ili9342c_ILI9342C_polyline(mp_obj_t self_in, mp_obj_t points_in, mp_obj_t color_in) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(self_in);
+	points_t points;
+	spans_t spans;
+
+	points_init(&points, points_in);
+	spans_init(&spans, self, mp_obj_get_int(color_in));
+	mp_int_t x0 = 0, y0 = 0;
+	for (size_t i = 0; i < points.count; i++) {
+		mp_int_t x1, y1;
+		points_get(&points, i, &x1, &y1);
+		if (i == 0) {
+			x0 = x1;
+			y0 = y1;
+		}
+		if (i || points.count == 1) {
+			spans_line(&spans, x0, y0, x1, y1);
+		}
+		x0 = x1;
+		y0 = y1;
+	}
+	spans_flush(&spans);
+	queue_flush(self);
+
+	return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_3(ili9342c_ILI9342C_polyline_obj, ili9342c_ILI9342C_polyline);
+
+//
+// Shapes
+//
+// Outlines are stepped as their whole shape with each point or run clipped
+// to the display as it is added to a span batcher. Circles, ellipses and
+// rounded rectangles are filled by stepping the same outline while recording
+// the leftmost and rightmost point of each display row, then sending a span
+// for each row, so a fill covers exactly its outline and what is inside it.
+// Triangles and polygons are filled a row at a time from an edge table:
+// the row of pixels each edge's line has on a row, with the edges crossing
+// it paired by the even-odd rule and the pixels between each pair filled.
+//
+
+// add the run x0, y0 to x1, y1 of a row or column, x0 <= x1 and y0 <= y1,
+// clipped to the display, or add it to the extents of the rows it is on
+static void spans_run(spans_t *spans, int64_t x0, int64_t y0, int64_t x1, int64_t y1) {
+	ili9342c_ILI9342C_obj_t *self = spans->self;
+
+	y0 = MAX(y0, 0);
+	y1 = MIN(y1, self->height - 1);
+	if (spans->left) {
+		x0 = MIN(MAX(x0, -1), self->width);
+		x1 = MIN(MAX(x1, -1), self->width);
+		for (int64_t y = y0; y <= y1; y++) {
+			spans->left[y]	= MIN(spans->left[y], x0);
+			spans->right[y] = MAX(spans->right[y], x1);
+		}
+		return;
+	}
+	x0 = MAX(x0, 0);
+	x1 = MIN(x1, self->width - 1);
+	if (x0 <= x1 && y0 <= y1) {
+		spans_add(spans, x0, y0, x1, y1);
+	}
+}
+
+// record the extents of the display rows the runs added to spans are on,
+// in left and right entries allocated for each row, instead of drawing them
+static void spans_rows(spans_t *spans) {
+	ili9342c_ILI9342C_obj_t *self = spans->self;
+	int16_t *left = m_new(int16_t, 2 * self->height);
+	int16_t *right = left + self->height;
+
+	for (int16_t y = 0; y < self->height; y++) {
+		left[y]	 = self->width;
+		right[y] = -1;
+	}
+	spans->left	 = left;
+	spans->right = right;
+}
+
+// draw the span of each row recorded since spans_rows and free the rows
+static void spans_fill_rows(spans_t *spans) {
+	ili9342c_ILI9342C_obj_t *self = spans->self;
+	int16_t *left = spans->left, *right = spans->right;
+
+	spans->left	 = NULL;
+	spans->right = NULL;
+	for (int16_t y = 0; y < self->height; y++) {
+		int16_t x0 = MAX(left[y], 0);
+		int16_t x1 = MIN(right[y], self->width - 1);
+		if (x0 <= x1) {
+			spans_add(spans, x0, y, x1, y);
+		}
+	}
+	m_del(int16_t, left, 2 * self->height);
+}
+
+// largest radius stepped, as far as an int16 coordinate can reach
+#define SHAPE_RADIUS_MAX INT16_MAX
+
+// true if the box x0, y0 to x1, y1 is all off the display
+static bool spans_off(spans_t *spans, int64_t x0, int64_t y0, int64_t x1, int64_t y1) {
+	return x1 < 0 || y1 < 0 || x0 >= spans->self->width || y0 >= spans->self->height;
+}
+
+// add the quarter of the circle of radius r about x, y given by quarter: 0
+// top right, 1 bottom right, 2 bottom left or 3 top left. Each of its two
+// octants is stepped from its axis, so each point touches the one before.
+static void spans_arc(spans_t *spans, int64_t x, int64_t y, int64_t r, int quarter) {
+	int64_t sx = (quarter < 2) ? 1 : -1;
+	int64_t sy = (quarter == 1 || quarter == 2) ? 1 : -1;
+
+	for (int octant = 0; octant < 2; octant++) {
+		int64_t px = r, py = 0, err = 1 - r;
+		while (px >= py) {
+			int64_t ax = x + sx * ((octant) ? py : px);
+			int64_t ay = y + sy * ((octant) ? px : py);
+			spans_run(spans, ax, ay, ax, ay);
+			py++;
+			if (err < 0) {
+				err += 2 * py + 1;
+			} else {
+				px--;
+				err += 2 * (py - px) + 1;
+			}
+		}
+	}
+}
+
+static void spans_circle(spans_t *spans, int64_t x, int64_t y, int64_t r) {
+	r = MIN(r, SHAPE_RADIUS_MAX);
+	if (r < 0 || spans_off(spans, x - r, y - r, x + r, y + r)) {
+		return;
+	}
+	for (int quarter = 0; quarter < 4; quarter++) {
+		spans_arc(spans, x, y, r, quarter);
+	}
+}
+
+// add the ellipse with radii rx and ry about x, y, each quarter stepped from
+// its top or bottom where the slope is shallow then on from where it is steep
+static void spans_ellipse(spans_t *spans, int64_t x, int64_t y, int64_t rx, int64_t ry) {
+	rx = MIN(rx, SHAPE_RADIUS_MAX);
+	ry = MIN(ry, SHAPE_RADIUS_MAX);
+	if (rx < 0 || ry < 0 || spans_off(spans, x - rx, y - ry, x + rx, y + ry)) {
+		return;
+	}
+	if (rx == 0) {
+		spans_run(spans, x, y - ry, x, y + ry);
+		return;
+	}
+	if (ry == 0) {
+		spans_run(spans, x - rx, y, x + rx, y);
+		return;
+	}
+
+	int64_t rx2 = rx * rx, ry2 = ry * ry;
+	for (int quarter = 0; quarter < 4; quarter++) {
+		int64_t sx = (quarter < 2) ? 1 : -1;
+		int64_t sy = (quarter == 1 || quarter == 2) ? 1 : -1;
+		int64_t px = 0, py = ry;
+		int64_t dx = 0, dy = 2 * rx2 * py;
+		int64_t p = ry2 - rx2 * ry + rx2 / 4;
+
+		while (dx < dy) {
+			spans_run(spans, x + sx * px, y + sy * py, x + sx * px, y + sy * py);
+			px++;
+			dx += 2 * ry2;
+			if (p < 0) {
+				p += ry2 + dx;
+			} else {
+				py--;
+				dy -= 2 * rx2;
+				p += ry2 + dx - dy;
+			}
+		}
+
+		p = ry2 * (px * px + px) + ry2 / 4 + rx2 * (py - 1) * (py - 1) - rx2 * ry2;
+		while (py >= 0) {
+			spans_run(spans, x + sx * px, y + sy * py, x + sx * px, y + sy * py);
+			py--;
+			dy -= 2 * rx2;
+			if (p > 0) {
+				p += rx2 - dy;
+			} else {
+				px++;
+				dx += 2 * ry2;
+				p += rx2 - dy + dx;
+			}
+		}
+	}
+}
+
+// add the rectangle x, y, w, h with corners of radius r, which is limited to
+// half its shorter side
+static void spans_round_rect(spans_t *spans, int64_t x, int64_t y, int64_t w, int64_t h, int64_t r) {
+	if (w <= 0 || h <= 0 || spans_off(spans, x, y, x + w - 1, y + h - 1)) {
+		return;
+	}
+	r = MIN(MIN(MAX(r, 0), (MIN(w, h) - 1) / 2), SHAPE_RADIUS_MAX);
+
+	int64_t x1 = x + w - 1, y1 = y + h - 1;
+	spans_run(spans, x + r, y, x1 - r, y);
+	spans_arc(spans, x1 - r, y + r, r, 0);
+	spans_run(spans, x1, y + r, x1, y1 - r);
+	spans_arc(spans, x1 - r, y1 - r, r, 1);
+	spans_run(spans, x + r, y1, x1 - r, y1);
+	spans_arc(spans, x + r, y1 - r, r, 2);
+	spans_run(spans, x, y + r, x, y1 - r);
+	spans_arc(spans, x + r, y + r, r, 3);
+}
+
+// add the lines joining the count points x0, y0, x1, y1, ... in xy and the
+// last back to the first
+static void spans_polygon(spans_t *spans, const mp_int_t *xy, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		size_t j = (i + 1 == count) ? 0 : i + 1;
+		spans_line(spans, xy[2 * i], xy[2 * i + 1], xy[2 * j], xy[2 * j + 1]);
+	}
+}
+
+// an edge of a polygon, its line's ends ordered the way spans_line steps
+// them: along the axis it changes most on, rows for a steep edge
+typedef struct {
+	int64_t x0, y0;					// the end it is stepped from
+	int64_t major, minor;			// lengths along the axis stepped and the other
+	int64_t step;					// direction of the other axis, 1 or -1
+	int64_t top, bottom;			// first and last row
+	bool steep;
+} edge_t;
+
+static void edge_init(edge_t *edge, int64_t x0, int64_t y0, int64_t x1, int64_t y1) {
+	edge->steep = ABS(y1 - y0) > ABS(x1 - x0);
+	if ((edge->steep) ? y0 > y1 : x0 > x1) {
+		_swap_int64_t(x0, x1);
+		_swap_int64_t(y0, y1);
+	}
+	edge->x0	 = x0;
+	edge->y0	 = y0;
+	edge->major	 = (edge->steep) ? y1 - y0 : x1 - x0;
+	edge->minor	 = (edge->steep) ? ABS(x1 - x0) : ABS(y1 - y0);
+	edge->step	 = ((edge->steep) ? x0 < x1 : y0 < y1) ? 1 : -1;
+	edge->top	 = MIN(y0, y1);
+	edge->bottom = MAX(y0, y1);
+}
+
+// the pixels a, b the edge's line has on row y, as spans_line draws it: step k
+// is moved m along the other axis, the least m with e0 - k * minor + m * major >= 0
+static void edge_row(const edge_t *edge, int64_t y, int64_t *a, int64_t *b) {
+	int64_t e0 = edge->major >> 1;
+
+	if (edge->steep) {
+		int64_t k = y - edge->y0;
+		int64_t m = (k * edge->minor > e0) ? (k * edge->minor - e0 + edge->major - 1) / edge->major : 0;
+		*a = *b = edge->x0 + edge->step * m;
+	} else if (edge->minor == 0) {
+		*a = edge->x0;
+		*b = edge->x0 + edge->major;
+	} else {
+		int64_t m = (y - edge->y0) * edge->step;
+		*a = edge->x0 + ((m) ? ((m - 1) * edge->major + e0) / edge->minor + 1 : 0);
+		*b = edge->x0 + MIN(edge->major, (m * edge->major + e0) / edge->minor);
+	}
+}
+
+// insert the run a, b into the count runs in order of a at runs
+static size_t runs_insert(int64_t *runs, size_t count, int64_t a, int64_t b) {
+	size_t i = count;
+	for (; i > 0 && runs[2 * i - 2] > a; i--) {
+		runs[2 * i]		= runs[2 * i - 2];
+		runs[2 * i + 1] = runs[2 * i - 1];
+	}
+	runs[2 * i]		= a;
+	runs[2 * i + 1] = b;
+	return count + 1;
+}
+
+// add the polygon of the count points in xy filled by the even-odd rule.
+// The edges are sorted by their first row into an edge table, and those on
+// each row are kept in an active list. An edge starting or going on past a
+// row crosses it, one ending on it or level with it only adds its pixels,
+// so a vertex the outline passes through counts once and a peak not at all.
+static void spans_fill_polygon(spans_t *spans, const mp_int_t *xy, size_t count) {
+	ili9342c_ILI9342C_obj_t *self = spans->self;
+
+	if (count == 0) {
+		return;
+	}
+
+	edge_t *edges	= m_new(edge_t, count);
+	size_t *active	= m_new(size_t, count);
+	int64_t *cross	= m_new(int64_t, 2 * count);
+	int64_t *runs	= m_new(int64_t, 2 * count);
+	int64_t top		= INT64_MAX, bottom = INT64_MIN;
+
+	for (size_t i = 0; i < count; i++) {
+		size_t j = (i + 1 == count) ? 0 : i + 1;
+		edge_t edge;
+		edge_init(&edge, xy[2 * i], xy[2 * i + 1], xy[2 * j], xy[2 * j + 1]);
+		size_t k = i;
+		for (; k > 0 && edges[k - 1].top > edge.top; k--) {
+			edges[k] = edges[k - 1];
+		}
+		edges[k] = edge;
+		top		 = MIN(top, edge.top);
+		bottom	 = MAX(bottom, edge.bottom);
+	}
+
+	size_t next = 0, n_active = 0;
+	for (int64_t y = MAX(top, 0); y <= MIN(bottom, self->height - 1); y++) {
+		for (; next < count && edges[next].top <= y; next++) {
+			active[n_active++] = next;
+		}
+
+		size_t n_cross = 0, n_runs = 0, kept = 0;
+		for (size_t i = 0; i < n_active; i++) {
+			const edge_t *edge = &edges[active[i]];
+			int64_t a, b;
+			if (edge->bottom < y) {
+				continue;
+			}
+			active[kept++] = active[i];
+			edge_row(edge, y, &a, &b);
+			if (y < edge->bottom) {
+				n_cross = runs_insert(cross, n_cross, a, b);
+			} else {
+				n_runs = runs_insert(runs, n_runs, a, b);
+			}
+		}
+		n_active = kept;
+
+		for (size_t i = 0; i + 1 < n_cross; i += 2) {
+			int64_t a = MIN(cross[2 * i], cross[2 * i + 2]);
+			int64_t b = MAX(cross[2 * i + 1], cross[2 * i + 3]);
+			n_runs	  = runs_insert(runs, n_runs, a, b);
+		}
+		if (n_cross & 1) {
+			n_runs = runs_insert(runs, n_runs, cross[2 * n_cross - 2], cross[2 * n_cross - 1]);
+		}
+
+		// merge the runs that overlap or touch into spans
+		for (size_t i = 0; i < n_runs;) {
+			int64_t a = runs[2 * i], b = runs[2 * i + 1];
+			for (i++; i < n_runs && runs[2 * i] <= b + 1; i++) {
+				b = MAX(b, runs[2 * i + 1]);
+			}
+			spans_run(spans, a, y, b, y);
+		}
+	}
+
+	m_del(int64_t, runs, 2 * count);
+	m_del(int64_t, cross, 2 * count);
+	m_del(size_t, active, count);
+	m_del(edge_t, edges, count);
+}
+
+//
+//	circle(x, y, r, color) draws a circle of radius r centered on x, y
+//
+
+static mp_obj_t ili9342c_ILI9342C_circle(size_t n_args, const mp_obj_t *args) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+	spans_t spans;
+
+	spans_init(&spans, self, mp_obj_get_int(args[4]));
+	spans_circle(&spans, mp_obj_get_int(args[1]), mp_obj_get_int(args[2]), mp_obj_get_int(args[3]));
+	spans_flush(&spans);
+	queue_flush(self);
+
+	return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_circle_obj, 5, 5, ili9342c_ILI9342C_circle);
+
+//
+//	fill_circle(x, y, r, color) draws a filled circle of radius r centered on x, y
+//
+
+static mp_obj_t ili9342c_ILI9342C_fill_circle(size_t n_args, const mp_obj_t *args) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+	spans_t spans;
+
+	spans_init(&spans, self, mp_obj_get_int(args[4]));
+	spans_rows(&spans);
+	spans_circle(&spans, mp_obj_get_int(args[1]), mp_obj_get_int(args[2]), mp_obj_get_int(args[3]));
+	spans_fill_rows(&spans);
+	spans_flush(&spans);
+	queue_flush(self);
+
+	return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_fill_circle_obj, 5, 5, ili9342c_ILI9342C_fill_circle);
+
+//
+//	ellipse(x, y, rx, ry, color) draws an ellipse with radii rx and ry
+//	centered on x, y
+//
+
+static mp_obj_t ili9342c_ILI9342C_ellipse(size_t n_args, const mp_obj_t *args) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+	spans_t spans;
+
+	spans_init(&spans, self, mp_obj_get_int(args[5]));
+	spans_ellipse(&spans, mp_obj_get_int(args[1]), mp_obj_get_int(args[2]), mp_obj_get_int(args[3]), mp_obj_get_int(args[4]));
+	spans_flush(&spans);
+	queue_flush(self);
+
+	return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_ellipse_obj, 6, 6, ili9342c_ILI9342C_ellipse);
+
+//
+//	fill_ellipse(x, y, rx, ry, color) draws a filled ellipse with radii rx
+//	and ry centered on x, y
+//
+
+static mp_obj_t ili9342c_ILI9342C_fill_ellipse(size_t n_args, const mp_obj_t *args) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+	spans_t spans;
+
+	spans_init(&spans, self, mp_obj_get_int(args[5]));
+	spans_rows(&spans);
+	spans_ellipse(&spans, mp_obj_get_int(args[1]), mp_obj_get_int(args[2]), mp_obj_get_int(args[3]), mp_obj_get_int(args[4]));
+	spans_fill_rows(&spans);
+	spans_flush(&spans);
+	queue_flush(self);
+
+	return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_fill_ellipse_obj, 6, 6, ili9342c_ILI9342C_fill_ellipse);
+
+//
+//	round_rect(x, y, w, h, r, color) draws a rectangle with corners of radius r
+//
+
+static mp_obj_t ili9342c_ILI9342C_round_rect(size_t n_args, const mp_obj_t *args) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+	spans_t spans;
+
+	spans_init(&spans, self, mp_obj_get_int(args[6]));
+	spans_round_rect(&spans, mp_obj_get_int(args[1]), mp_obj_get_int(args[2]), mp_obj_get_int(args[3]), mp_obj_get_int(args[4]), mp_obj_get_int(args[5]));
+	spans_flush(&spans);
+	queue_flush(self);
+
+	return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_round_rect_obj, 7, 7, ili9342c_ILI9342C_round_rect);
+
+//
+//	fill_round_rect(x, y, w, h, r, color) draws a filled rectangle with
+//	corners of radius r
+//
+
+static mp_obj_t ili9342c_ILI9342C_fill_round_rect(size_t n_args, const mp_obj_t *args) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+	spans_t spans;
+
+	spans_init(&spans, self, mp_obj_get_int(args[6]));
+	spans_rows(&spans);
+	spans_round_rect(&spans, mp_obj_get_int(args[1]), mp_obj_get_int(args[2]), mp_obj_get_int(args[3]), mp_obj_get_int(args[4]), mp_obj_get_int(args[5]));
+	spans_fill_rows(&spans);
+	spans_flush(&spans);
+	queue_flush(self);
+
+	return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_fill_round_rect_obj, 7, 7, ili9342c_ILI9342C_fill_round_rect);
+
+// the corners x0, y0, x1, y1, x2, y2 of a triangle from args
+static void triangle_get(const mp_obj_t *args, mp_int_t *xy) {
+	for (int i = 0; i < 6; i++) {
+		xy[i] = mp_obj_get_int(args[i]);
+	}
+}
+
+//
+//	triangle(x0, y0, x1, y1, x2, y2, color) draws a triangle with the corners
+//	x0, y0, x1, y1 and x2, y2
+//
+
+static mp_obj_t ili9342c_ILI9342C_triangle(size_t n_args, const mp_obj_t *args) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+	mp_int_t xy[6];
+	spans_t spans;
+
+	triangle_get(&args[1], xy);
+	spans_init(&spans, self, mp_obj_get_int(args[7]));
+	spans_polygon(&spans, xy, 3);
+	spans_flush(&spans);
+	queue_flush(self);
+
+	return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_triangle_obj, 8, 8, ili9342c_ILI9342C_triangle);
+
+//
+//	fill_triangle(x0, y0, x1, y1, x2, y2, color) draws a filled triangle with
+//	the corners x0, y0, x1, y1 and x2, y2
+//
+
+static mp_obj_t ili9342c_ILI9342C_fill_triangle(size_t n_args, const mp_obj_t *args) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+	mp_int_t xy[6];
+	spans_t spans;
+
+	triangle_get(&args[1], xy);
+	spans_init(&spans, self, mp_obj_get_int(args[7]));
+	spans_fill_polygon(&spans, xy, 3);
+	spans_flush(&spans);
+	queue_flush(self);
+
+	return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_fill_triangle_obj, 8, 8, ili9342c_ILI9342C_fill_triangle);
+
+// the points of a polygon from points_in moved by x, y, as x0, y0, x1, y1, ...
+// in a new array of count points
+static mp_int_t *polygon_get(mp_obj_t points_in, mp_obj_t x_in, mp_obj_t y_in, size_t *count) {
+	points_t points;
+	mp_int_t x = mp_obj_get_int(x_in);
+	mp_int_t y = mp_obj_get_int(y_in);
+
+	points_init(&points, points_in);
+	mp_int_t *xy = m_new(mp_int_t, 2 * points.count);
+	for (size_t i = 0; i < points.count; i++) {
+		points_get(&points, i, &xy[2 * i], &xy[2 * i + 1]);
+		xy[2 * i] += x;
+		xy[2 * i + 1] += y;
+	}
+	*count = points.count;
+	return xy;
+}
+
+//
+//	polygon(points, x, y, color) draws the closed polygon with the points
+//	x0, y0, x1, y1, ..., given as in polyline(), moved by x, y
+//
+
+static mp_obj_t ili9342c_ILI9342C_polygon(size_t n_args, const mp_obj_t *args) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+	size_t count;
+	mp_int_t *xy = polygon_get(args[1], args[2], args[3], &count);
+	spans_t spans;
+
+	spans_init(&spans, self, mp_obj_get_int(args[4]));
+	spans_polygon(&spans, xy, count);
+	spans_flush(&spans);
+	queue_flush(self);
+	m_del(mp_int_t, xy, 2 * count);
+
+	return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_polygon_obj, 5, 5, ili9342c_ILI9342C_polygon);
+
+//
+//	fill_polygon(points, x, y, color) draws the polygon with the points
+//	x0, y0, x1, y1, ..., given as in polyline(), moved by x, y, filled by the
+//	even-odd rule
+//
+
+static mp_obj_t ili9342c_ILI9342C_fill_polygon(size_t n_args, const mp_obj_t *args) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+	size_t count;
+	mp_int_t *xy = polygon_get(args[1], args[2], args[3], &count);
+	spans_t spans;
+
+	spans_init(&spans, self, mp_obj_get_int(args[4]));
+	spans_fill_polygon(&spans, xy, count);
+	spans_flush(&spans);
+	queue_flush(self);
+	m_del(mp_int_t, xy, 2 * count);
+
+	return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_fill_polygon_obj, 5, 5, ili9342c_ILI9342C_fill_polygon);
+
+static mp_obj_t ili9342c_ILI9342C_blit_buffer(size_t n_args, const mp_obj_t *args) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+
+	mp_buffer_info_t buf_info;
+	mp_get_buffer_raise(args[1], &buf_info, MP_BUFFER_READ);
+	mp_int_t x = mp_obj_get_int(args[2]);
+	mp_int_t y = mp_obj_get_int(args[3]);
+	mp_int_t w = mp_obj_get_int(args[4]);
+	mp_int_t h = mp_obj_get_int(args[5]);
+
+	set_window(self, x, y, x + w - 1, y + h - 1);
+	write_data(self, (const uint8_t *) buf_info.buf, MIN(buf_info.len, w * h * 2));
+	queue_flush(self);
+
+	return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_blit_buffer_obj, 6, 6, ili9342c_ILI9342C_blit_buffer);
+
+static mp_obj_t ili9342c_ILI9342C_blit_buffer_async(size_t n_args, const mp_obj_t *args) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+
+	// framebuffer and band mode drawing does not use the bus
+	if (self->frame_buffer || self->display_list) {
+		return ili9342c_ILI9342C_blit_buffer(n_args, args);
+	}
+
+	mp_buffer_info_t buf_info;
+	mp_get_buffer_raise(args[1], &buf_info, MP_BUFFER_READ);
+	mp_int_t x = mp_obj_get_int(args[2]);
+	mp_int_t y = mp_obj_get_int(args[3]);
+	mp_int_t w = mp_obj_get_int(args[4]);
+	mp_int_t h = mp_obj_get_int(args[5]);
+	uint32_t len = MIN(buf_info.len, w * h * 2);
+
+	// fill the buffer not being sent while the last transfer runs
+	uint8_t next = self->async_next;
+	if (self->async_size[next] < len) {
+		m_free(self->async_buffer[next]);
+		self->async_buffer[next] = m_malloc(len);
+		self->async_size[next] = len;
+	}
+	memcpy(self->async_buffer[next], buf_info.buf, len);
+
+	set_window(self, x, y, x + w - 1, y + h - 1);
+	queue_write(self, 1, NULL, 0);
+	queue_send(self);
+	DC_HIGH();
+	async_start(self, self->async_buffer[next], len);
+	self->async_next = next ^ 1;
+
+	return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_blit_buffer_async_obj, 6, 6, ili9342c_ILI9342C_blit_buffer_async);
+
+static mp_obj_t ili9342c_ILI9342C_wait(mp_obj_t self_in) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(self_in);
+	async_wait(self);
+	return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(ili9342c_ILI9342C_wait_obj, ili9342c_ILI9342C_wait);
+
+
+//
+// Fonts
+//
+// load_font() resolves the tables and sizes of a font module once into a
+// Font object, along with a byte to glyph index for write() fonts. The text
+// methods take a Font or the module itself, a module is resolved on each
+// call without the index.
+//
+
+#define FONT_TEXT		1			// text() bitmap fonts
+#define FONT_WRITE		2			// write() proportional fonts
+#define FONT_HERSHEY	3			// draw() vector fonts
+
+#define GLYPH_NONE		0xffff		// map_index entry for bytes not in MAP
+
+typedef struct _ili9342c_Font_obj_t {
+	mp_obj_base_t	 base;
+	mp_obj_t		 module;		// holds the tables below
+	uint8_t			 kind;
+	uint8_t			 width;			// text() glyph width
+	uint8_t			 height;
+	uint8_t			 first;			// text() first and last characters
+	uint8_t			 last;
+	uint8_t			 bpp;			// write() bits per pixel
+	uint8_t			 offset_width;	// write() bytes per OFFSETS entry
+	uint8_t			 max_width;		// write() widest glyph
+	const char		*map;			// write() characters in the font
+	uint16_t		*map_index;		// glyph of each byte, NULL if not built
+	const uint8_t	*widths;		// write() glyph widths
+	const uint8_t	*offsets;		// write() glyph bit offsets
+	const uint8_t	*bitmaps;		// write() glyph bitmaps
+	const uint8_t	*index;			// draw() glyph offsets
+	const uint8_t	*data;			// text() bitmaps, draw() vectors
+} ili9342c_Font_obj_t;
+
+static const uint8_t *font_buffer(mp_obj_dict_t *dict, qstr name) {
+	mp_buffer_info_t bufinfo;
+	mp_get_buffer_raise(mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(name)), &bufinfo, MP_BUFFER_READ);
+	return bufinfo.buf;
+}
+
+static mp_int_t font_int(mp_obj_dict_t *dict, qstr name) {
+	return mp_obj_get_int(mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(name)));
+}
+
+static void font_load(ili9342c_Font_obj_t *font, mp_obj_t module_in, uint8_t kind) {
+	mp_obj_module_t *module = MP_OBJ_TO_PTR(module_in);
+	mp_obj_dict_t	*dict	= MP_OBJ_TO_PTR(module->globals);
+
+	font->module	= module_in;
+	font->kind		= kind;
+	font->map_index = NULL;
+
+	switch (kind) {
+		case FONT_TEXT:
+			font->width	 = font_int(dict, MP_QSTR_WIDTH);
+			font->height = font_int(dict, MP_QSTR_HEIGHT);
+			font->first	 = font_int(dict, MP_QSTR_FIRST);
+			font->last	 = font_int(dict, MP_QSTR_LAST);
+			font->data	 = font_buffer(dict, MP_QSTR_FONT);
+			break;
+
+		case FONT_WRITE:
+			font->map		   = mp_obj_str_get_str(mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_MAP)));
+			font->bpp		   = font_int(dict, MP_QSTR_BPP);
+			if (font->bpp < 1 || font->bpp > 8) {
+				mp_raise_ValueError(MP_ERROR_TEXT("BPP must be 1 to 8"));
+			}
+			font->height	   = font_int(dict, MP_QSTR_HEIGHT);
+			font->offset_width = font_int(dict, MP_QSTR_OFFSET_WIDTH);
+			font->max_width	   = font_int(dict, MP_QSTR_MAX_WIDTH);
+			font->widths	   = font_buffer(dict, MP_QSTR_WIDTHS);
+			font->offsets	   = font_buffer(dict, MP_QSTR_OFFSETS);
+			font->bitmaps	   = font_buffer(dict, MP_QSTR_BITMAPS);
+			break;
+
+		case FONT_HERSHEY:
+			font->index = font_buffer(dict, MP_QSTR_INDEX);
+			font->data	= font_buffer(dict, MP_QSTR_FONT);
+			break;
+	}
+}
+
+extern const mp_obj_type_t ili9342c_Font_type;
+
+// the Font passed, or the module resolved into tmp
+static const ili9342c_Font_obj_t *font_get(mp_obj_t font_in, uint8_t kind, ili9342c_Font_obj_t *tmp) {
+	if (mp_obj_is_type(font_in, &ili9342c_Font_type)) {
+		ili9342c_Font_obj_t *font = MP_OBJ_TO_PTR(font_in);
+		if (font->kind != kind) {
+			mp_raise_TypeError(MP_ERROR_TEXT("wrong font type"));
+		}
+		return font;
+	}
+	font_load(tmp, font_in, kind);
+	return tmp;
+}
+
+// index of the glyph for chr in a write() font, -1 if not in the font
+static int font_glyph(const ili9342c_Font_obj_t *font, uint8_t chr) {
+	if (font->map_index) {
+		uint16_t glyph = font->map_index[chr];
+		return (glyph == GLYPH_NONE) ? -1 : glyph;
+	}
+	const char *char_pointer = strchr(font->map, chr);
+	return char_pointer ? char_pointer - font->map : -1;
+}
+
+// first bit of a glyph in a write() font
+static uint32_t font_offset(const ili9342c_Font_obj_t *font, int glyph) {
+	const uint8_t *offset = font->offsets + glyph * font->offset_width;
+
+	switch (font->offset_width) {
+		case 1:
+			return offset[0];
+		case 2:
+			return (offset[0] << 8) + offset[1];
+		case 3:
+			return (offset[0] << 16) + (offset[1] << 8) + offset[2];
+	}
+	return 0;
+}
+
+static void ili9342c_Font_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind) {
+	(void) kind;
+	ili9342c_Font_obj_t *self = MP_OBJ_TO_PTR(self_in);
+	static const char *kinds[] = {"", "text", "write", "hershey"};
+	mp_printf(print, "<Font %s height=%u>", kinds[self->kind], self->height);
+}
+
+#ifdef MP_OBJ_TYPE_GET_SLOT
+
+MP_DEFINE_CONST_OBJ_TYPE(
+    ili9342c_Font_type,
+    MP_QSTR_Font,
+    MP_TYPE_FLAG_NONE,
+    print, ili9342c_Font_print);
+
+#else
+
+const mp_obj_type_t ili9342c_Font_type = {
+	{&mp_type_type},
+	.name  = MP_QSTR_Font,
+	.print = ili9342c_Font_print,
+};
+
+#endif
+
+// the strokes of a string in a Hershey font
+typedef struct {
+	int16_t *xy;					// x0, y0, x1, y1 of each stroke
+	size_t count;					// number of strokes
+	size_t alloc;					// strokes xy has room for
+	size_t *glyphs;					// first stroke of each character, and the end of the last
+} strokes_t;
+
+static void strokes_add(strokes_t *strokes, int16_t x0, int16_t y0, int16_t x1, int16_t y1) {
+	if (strokes->count == strokes->alloc) {
+		size_t alloc = (strokes->alloc) ? strokes->alloc * 2 : 64;
+		strokes->xy	 = m_renew(int16_t, strokes->xy, strokes->alloc * 4, alloc * 4);
+		strokes->alloc = alloc;
+	}
+	int16_t *xy = &strokes->xy[strokes->count++ * 4];
+	xy[0] = x0;
+	xy[1] = y0;
+	xy[2] = x1;
+	xy[3] = y1;
+}
+
+// the strokes of s drawn at x, y in a Hershey font at scale
+static void hershey_strokes(strokes_t *strokes, const ili9342c_Font_obj_t *hershey, const char *s, mp_int_t x, mp_int_t y, mp_float_t scale) {
+	const uint8_t *index = hershey->index;
+	const int8_t  *font	 = (const int8_t *) hershey->data;
+
+	strokes->xy		= NULL;
+	strokes->count	= 0;
+	strokes->alloc	= 0;
+	strokes->glyphs = m_new(size_t, strlen(s) + 1);
+
+    int16_t from_x = x;
+    int16_t from_y  = y;
+    int16_t to_x = x;
+    int16_t to_y = y;
+    int16_t pos_x = x;
+    int16_t pos_y = y;
+    bool penup = true;
+    char c;
+    int16_t ii;
+	size_t glyph = 0;
+
+    while ((c = *s++)) {
+		strokes->glyphs[glyph++] = strokes->count;
+        if (c >= 32 && c <= 127) {
+            ii = (c-32) * 2;
+
+			int16_t offset = index[ii] | (index[ii+1] << 8);
+            int16_t length = font[offset++];
+            int16_t left = lround((font[offset++] - 0x52) * scale);
+            int16_t right = lround((font[offset++] - 0x52) * scale);
+            int16_t width = right - left;
+
+            if (length) {
+                int16_t i;
+                for (i = 0; i < length; i++) {
+                    if (font[offset] == ' ') {
+                        offset+=2;
+                        penup = true;
+                        continue;
+                    }
+
+                    int16_t vector_x = lround((font[offset++] - 0x52) * scale);
+                    int16_t vector_y = lround((font[offset++] - 0x52) * scale);
+
+                    if (!i ||  penup) {
+                        from_x = pos_x + vector_x - left;
+                        from_y = pos_y + vector_y;
+                    } else {
+                        to_x = pos_x + vector_x - left;
+                        to_y = pos_y + vector_y;
+
+                        strokes_add(strokes, from_x, from_y, to_x, to_y);
+                        from_x = to_x;
+                        from_y = to_y;
+                    }
+                    penup = false;
+                }
+            }
+			pos_x += width;
+        }
+    }
+	strokes->glyphs[glyph] = strokes->count;
+}
+
+// draw glyph g of strokes anti-aliased in one window of the box around its
+// strokes. The strokes of any other glyph reaching into the box are drawn in
+// it too, so neighbouring boxes that overlap do not cut into each other.
+static void aa_glyph(aa_t *aa, const strokes_t *strokes, size_t g, uint16_t **buf, size_t *buf_size) {
+	ili9342c_ILI9342C_obj_t *self = aa->self;
+	const int16_t *xy = strokes->xy;
+	int32_t x0 = INT32_MAX, y0 = INT32_MAX, x1 = INT32_MIN, y1 = INT32_MIN;
+
+	for (size_t i = strokes->glyphs[g]; i < strokes->glyphs[g + 1]; i++) {
+		x0 = MIN(x0, MIN(xy[4 * i], xy[4 * i + 2]));
+		y0 = MIN(y0, MIN(xy[4 * i + 1], xy[4 * i + 3]));
+		x1 = MAX(x1, MAX(xy[4 * i], xy[4 * i + 2]) + 1);
+		y1 = MAX(y1, MAX(xy[4 * i + 1], xy[4 * i + 3]) + 1);
+	}
+	x0 = MAX(x0, 0);
+	y0 = MAX(y0, 0);
+	x1 = MIN(x1, self->width - 1);
+	y1 = MIN(y1, self->height - 1);
+	if (x0 > x1 || y0 > y1) {
+		return;
+	}
+
+	size_t w = x1 - x0 + 1, pixels = w * (y1 - y0 + 1);
+	if (pixels > *buf_size) {
+		*buf	  = m_renew(uint16_t, *buf, *buf_size, pixels);
+		*buf_size = pixels;
+	}
+	memset(*buf, 0, pixels * 2);
+
+	aa->x0		 = x0;
+	aa->y0		 = y0;
+	aa->x1		 = x1;
+	aa->y1		 = y1;
+	aa->coverage = *buf;
+	for (size_t i = 0; i < strokes->count; i++) {
+		if (MAX(xy[4 * i], xy[4 * i + 2]) + 1 >= x0 && MIN(xy[4 * i], xy[4 * i + 2]) <= x1 &&
+			MAX(xy[4 * i + 1], xy[4 * i + 3]) + 1 >= y0 && MIN(xy[4 * i + 1], xy[4 * i + 3]) <= y1) {
+			aa_line(aa, xy[4 * i], xy[4 * i + 1], xy[4 * i + 2], xy[4 * i + 3]);
+		}
+	}
+	aa->coverage = NULL;
+
+	uint16_t *p = *buf;
+	for (int16_t y = y0; y <= y1; y++) {
+		for (int16_t x = x0; x <= x1; x++, p++) {
+			*p = _swap_bytes(aa_pixel(aa, x, y, *p));
+		}
+	}
+	set_window(self, x0, y0, x1, y1);
+	write_data(self, (const uint8_t *) *buf, pixels * 2);
+}
+
+//
+//	draw(font, s, x, y, color[, scale, background]) draws s in a Hershey font,
+//	anti-aliased over background when it is given, a color or True for the
+//	framebuffer's pixels
+//
+
+static mp_obj_t ili9342c_ILI9342C_draw(size_t n_args, const mp_obj_t *args) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+	char		single_char_s[] = {0, 0};
+	const char *s;
+
+	ili9342c_Font_obj_t tmp;
+	const ili9342c_Font_obj_t *hershey = font_get(args[1], FONT_HERSHEY, &tmp);
+
+	if (mp_obj_is_int(args[2])) {
+		mp_int_t c		 = mp_obj_get_int(args[2]);
+		single_char_s[0] = c & 0xff;
+		s				 = single_char_s;
+	} else {
+		s= mp_obj_str_get_str(args[2]);
+	}
+
+	mp_int_t		 x		   = mp_obj_get_int(args[3]);
+	mp_int_t		 y		   = mp_obj_get_int(args[4]);
+	mp_int_t		 color     = mp_obj_get_int(args[5]);
+
+    mp_float_t scale = 1.0;
+    if (n_args > 6 && mp_obj_is_float(args[6])) {
+        scale = mp_obj_float_get(args[6]);
+    }
+
+    if (n_args > 6 && mp_obj_is_int(args[6])) {
+        scale =  (float) mp_obj_get_int(args[6]);
+    }
+
+	aa_t aa;
+	bool smooth = n_args > 7 && args[7] != mp_const_none;
+	if (smooth) {
+		aa_init(&aa, self, color, args[7]);
+	}
+
+	strokes_t strokes;
+	hershey_strokes(&strokes, hershey, s, x, y, scale);
+	size_t glyphs = strlen(s);
+
+	if (smooth) {
+		uint16_t *buf = NULL;
+		size_t buf_size = 0;
+		for (size_t g = 0; g < glyphs; g++) {
+			aa_glyph(&aa, &strokes, g, &buf, &buf_size);
+		}
+		m_del(uint16_t, buf, buf_size);
+	} else {
+		for (size_t i = 0; i < strokes.count; i++) {
+			const int16_t *xy = &strokes.xy[4 * i];
+			line(self, xy[0], xy[1], xy[2], xy[3], color);
+		}
+	}
+	queue_flush(self);
+
+	m_del(size_t, strokes.glyphs, glyphs + 1);
+	m_del(int16_t, strokes.xy, strokes.alloc * 4);
+
+	return mp_const_none;
+}
+
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_draw_obj, 6, 8, ili9342c_ILI9342C_draw);
+
+
+//
+// Bit unpacking
+//
+// Font and bitmap pixels are packed MSB first, bpp bits each, with no padding
+// between rows. unpack_bits() keeps the bits in a 64 bit accumulator filled 32
+// bits at a time and looks each pixel up in a table of 1 << bpp colors. Words
+// are assembled from bytes as the tables need not be aligned.
+//
+
+// add the next word, or byte near the end, of src to the accumulator
+static inline const uint8_t *unpack_fill(const uint8_t *src, const uint8_t *end, uint64_t *acc, int *avail) {
+	if (end - src >= 4) {
+		*acc = (*acc << 32) | ((uint32_t) src[0] << 24) | ((uint32_t) src[1] << 16) | ((uint32_t) src[2] << 8) | src[3];
+		*avail += 32;
+		return src + 4;
+	}
+	*acc = (*acc << 8) | *src;
+	*avail += 8;
+	return src + 1;
+}
+
+// expand count pixels starting at bit of src through colors into dst
+static void unpack_bits(const uint8_t *src, uint32_t bit, uint8_t bpp, const uint16_t *colors, uint16_t *dst, uint32_t count) {
+	const uint8_t *end	 = src + (bit + count * bpp + 7) / 8;
+	const uint32_t mask	 = (1 << bpp) - 1;
+	uint64_t	   acc	 = 0;
+	int			   avail = 0;
+
+	src += bit / 8;
+	if (bit % 8) {
+		acc	  = *src++;
+		avail = 8 - bit % 8;
+	}
+
+	if (bpp == 1 && count >= 64) {
+		// four pixels for each nibble
+		uint16_t quads[16][4];
+		for (int n = 0; n < 16; n++) {
+			for (int i = 0; i < 4; i++) {
+				quads[n][i] = colors[(n >> (3 - i)) & 1];
+			}
+		}
+		while (count >= 4) {
+			if (avail < 4) {
+				src = unpack_fill(src, end, &acc, &avail);
+			}
+			avail -= 4;
+			memcpy(dst, quads[(acc >> avail) & 15], sizeof(quads[0]));
+			dst += 4;
+			count -= 4;
+		}
+	}
+
+	while (count--) {
+		if (avail < bpp) {
+			src = unpack_fill(src, end, &acc, &avail);
+		}
+		avail -= bpp;
+		*dst++ = colors[(acc >> avail) & mask];
+	}
+}
+
+
+mp_obj_t dict_lookup(mp_obj_t self_in, mp_obj_t index) {
+    mp_obj_dict_t *self = MP_OBJ_TO_PTR(self_in);
+    mp_map_elem_t *elem = mp_map_lookup(&self->map, index, MP_MAP_LOOKUP);
+    if (elem == NULL) {
+        return NULL;
+    } else {
+        return elem->value;
+    }
+}
+
+static mp_obj_t ili9342c_ILI9342C_write_len(size_t n_args, const mp_obj_t *args) {
+	ili9342c_Font_obj_t tmp;
+	const ili9342c_Font_obj_t *font = font_get(args[1], FONT_WRITE, &tmp);
+	char single_char_s[2] = {0, 0};
+	const char *str;
+
+	if (mp_obj_is_int(args[2])) {
+		mp_int_t c = mp_obj_get_int(args[2]);
+		single_char_s[0] = c & 0xff;
+		str	= single_char_s;
+	} else {
+		str = mp_obj_str_get_str(args[2]);
+	}
+
+	uint16_t print_width = 0;
+	uint8_t chr;
+
+	while ((chr = *str++)) {
+		int char_index = font_glyph(font, chr);
+		if (char_index >= 0) {
+			print_width += font->widths[char_index];
+        }
+    }
+	return mp_obj_new_int(print_width);
+}
+
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_write_len_obj, 3, 3, ili9342c_ILI9342C_write_len);
+
+
+//
+//	write(font_module, s, x, y[, fg, bg])
+//
+
+//
+// Glyph cache
+//
+// write() keeps the glyphs it renders, keyed by font, glyph and colors, so
+// text that is drawn again is sent without decoding the font bitmap. The
+// least recently used glyphs are dropped to keep within glyph_budget bytes.
+//
+
+static inline uint32_t glyph_hash(mp_obj_t font, uint16_t index, uint16_t fg_color, uint16_t bg_color) {
+	uint32_t hash = (uint32_t) (uintptr_t) font >> 2;
+	hash = (hash ^ index) * 0x9e3779b1;
+	hash ^= fg_color * 31 + bg_color;
+	return (hash ^ (hash >> 16)) % GLYPH_BUCKETS;
+}
+
+static void glyph_unlink(ili9342c_ILI9342C_obj_t *self, ili9342c_glyph_t *glyph) {
+	if (glyph->newer) {
+		glyph->newer->older = glyph->older;
+	} else {
+		self->glyph_newest = glyph->older;
+	}
+	if (glyph->older) {
+		glyph->older->newer = glyph->newer;
+	} else {
+		self->glyph_oldest = glyph->newer;
+	}
+	glyph->newer = NULL;
+	glyph->older = NULL;
+}
+
+static void glyph_link(ili9342c_ILI9342C_obj_t *self, ili9342c_glyph_t *glyph) {
+	glyph->older = self->glyph_newest;
+	if (self->glyph_newest) {
+		self->glyph_newest->newer = glyph;
+	} else {
+		self->glyph_oldest = glyph;
+	}
+	self->glyph_newest = glyph;
+}
+
+// drop the least recently used glyphs until bytes more would fit
+static void glyph_evict(ili9342c_ILI9342C_obj_t *self, uint32_t bytes) {
+	while (self->glyph_oldest && self->glyph_bytes + bytes > self->glyph_budget) {
+		ili9342c_glyph_t *glyph = self->glyph_oldest;
+		ili9342c_glyph_t **link = &self->glyph_buckets[glyph_hash(glyph->font, glyph->index, glyph->fg_color, glyph->bg_color)];
+		while (*link != glyph) {
+			link = &(*link)->chain;
+		}
+		*link = glyph->chain;
+		glyph_unlink(self, glyph);
+		self->glyph_bytes -= glyph->size;
+		self->glyph_count--;
+		m_free(glyph);
+	}
+}
+
+static void glyph_purge(ili9342c_ILI9342C_obj_t *self) {
+	uint32_t budget = self->glyph_budget;
+	self->glyph_budget = 0;
+	glyph_evict(self, 0);
+	self->glyph_budget = budget;
+}
+
+// the pixels of a cached glyph, or NULL if it is not in the cache
+static uint16_t *glyph_find(ili9342c_ILI9342C_obj_t *self, mp_obj_t font, uint16_t index, uint16_t fg_color, uint16_t bg_color) {
+	ili9342c_glyph_t *glyph = self->glyph_buckets[glyph_hash(font, index, fg_color, bg_color)];
+
+	while (glyph) {
+		if (glyph->font == font && glyph->index == index && glyph->fg_color == fg_color && glyph->bg_color == bg_color) {
+			if (glyph != self->glyph_newest) {
+				glyph_unlink(self, glyph);
+				glyph_link(self, glyph);
+			}
+			self->glyph_hits++;
+			return glyph->pixels;
+		}
+		glyph = glyph->chain;
+	}
+	self->glyph_misses++;
+	return NULL;
+}
+
+// pixels for a new cached glyph to be rendered into, NULL if it won't fit
+static uint16_t *glyph_add(ili9342c_ILI9342C_obj_t *self, mp_obj_t font, uint16_t index, uint16_t fg_color, uint16_t bg_color, uint32_t pixels) {
+	uint32_t size = sizeof(ili9342c_glyph_t) + pixels * 2;
+	if (size > self->glyph_budget || size > UINT16_MAX) {
+		return NULL;
+	}
+	glyph_evict(self, size);
+
+	ili9342c_glyph_t *glyph = m_malloc(size);
+	glyph->newer	= NULL;
+	glyph->font		= font;
+	glyph->index	= index;
+	glyph->fg_color = fg_color;
+	glyph->bg_color = bg_color;
+	glyph->size		= size;
+
+	uint32_t hash = glyph_hash(font, index, fg_color, bg_color);
+	glyph->chain = self->glyph_buckets[hash];
+	self->glyph_buckets[hash] = glyph;
+	glyph_link(self, glyph);
+	self->glyph_bytes += size;
+	self->glyph_count++;
+	return glyph->pixels;
+}
+
+static mp_obj_t ili9342c_ILI9342C_write(size_t n_args, const mp_obj_t *args) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+	ili9342c_Font_obj_t tmp;
+	const ili9342c_Font_obj_t *font = font_get(args[1], FONT_WRITE, &tmp);
+
+	char single_char_s[2] = {0, 0};
+	const char *str;
+
+	if (mp_obj_is_int(args[2])) {
+		mp_int_t c = mp_obj_get_int(args[2]);
+		single_char_s[0] = c & 0xff;
+		str	= single_char_s;
+	} else {
+		str = mp_obj_str_get_str(args[2]);
+	}
+
+	mp_int_t x = mp_obj_get_int(args[3]);
+	mp_int_t y = mp_obj_get_int(args[4]);
+	mp_int_t fg_color;
+	mp_int_t bg_color;
+
+	fg_color = (n_args > 5) ? _swap_bytes(mp_obj_get_int(args[5])) : _swap_bytes(WHITE);
+	bg_color = (n_args > 6) ? _swap_bytes(mp_obj_get_int(args[6])) : _swap_bytes(BLACK);
+
+	const uint8_t  bpp			  = font->bpp;
+	const uint8_t  height		  = font->height;
+	const uint8_t  max_width	  = font->max_width;
+
+	// any bits set draw in the foreground color
+	uint16_t colors[256];
+	colors[0] = bg_color;
+	for (int i = 1; i < (1 << bpp); i++) {
+		colors[i] = fg_color;
+	}
+
+	uint32_t buf_size = max_width * height * 2;
+	uint16_t *buffer = (self->buffer_size) ? self->i2c_buffer : NULL;
+
+	uint16_t print_width = 0;
+	uint8_t chr;
+
+	while ((chr = *str++)) {
+		int char_index = font_glyph(font, chr);
+		if (char_index >= 0) {
+			uint8_t width = font->widths[char_index];
+			uint16_t x1 = x + width - 1;
+			if (x1 >= self->width) {
+				break;
+			}
+
+			uint16_t *pixels = NULL;
+			bool	  render = true;
+			if (self->glyph_budget) {
+				pixels = glyph_find(self, font->module, char_index, fg_color, bg_color);
+				render = (pixels == NULL);
+				if (render) {
+					pixels = glyph_add(self, font->module, char_index, fg_color, bg_color, width * height);
+				}
+			}
+			if (pixels == NULL) {
+				if (buffer == NULL) {
+					buffer = m_malloc(buf_size);
+				}
+				pixels = buffer;
+			}
+
+			if (render) {
+				unpack_bits(font->bitmaps, font_offset(font, char_index), bpp, colors, pixels, width * height);
+			}
+
+			set_window(self, x, y, x1, y + height - 1);
+			write_data(self, (uint8_t *) pixels, width * height * 2);
+			print_width += width;
+			x += width;
+		}
+	}
+
+	if (self->buffer_size == 0 && buffer) {
+		m_free(buffer);
+	}
+	queue_flush(self);
+
+	return mp_obj_new_int(print_width);
+}
+
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_write_obj, 5, 7, ili9342c_ILI9342C_write);
+
+//
+//	glyph_cache([size]) sets the glyph cache size in bytes, returns the size
+//
+
+static mp_obj_t ili9342c_ILI9342C_glyph_cache(size_t n_args, const mp_obj_t *args) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+
+	if (n_args > 1) {
+		mp_int_t size = mp_obj_get_int(args[1]);
+		if (size < 0) {
+			mp_raise_ValueError(MP_ERROR_TEXT("size must be 0 or more"));
+		}
+		self->glyph_budget = size;
+		glyph_evict(self, 0);
+	}
+	return mp_obj_new_int_from_uint(self->glyph_budget);
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_glyph_cache_obj, 1, 2, ili9342c_ILI9342C_glyph_cache);
+
+//
+//	glyph_cache_stats() returns a dict of the glyph cache counters
+//
+
+static mp_obj_t ili9342c_ILI9342C_glyph_cache_stats(mp_obj_t self_in) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(self_in);
+	mp_obj_t dict = mp_obj_new_dict(5);
+
+	mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_size), mp_obj_new_int_from_uint(self->glyph_budget));
+	mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_bytes), mp_obj_new_int_from_uint(self->glyph_bytes));
+	mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_glyphs), mp_obj_new_int_from_uint(self->glyph_count));
+	mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_hits), mp_obj_new_int_from_uint(self->glyph_hits));
+	mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_misses), mp_obj_new_int_from_uint(self->glyph_misses));
+	return dict;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(ili9342c_ILI9342C_glyph_cache_stats_obj, ili9342c_ILI9342C_glyph_cache_stats);
+
+//
+//	glyph_cache_purge() drops every cached glyph and clears the counters
+//
+
+static mp_obj_t ili9342c_ILI9342C_glyph_cache_purge(mp_obj_t self_in) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(self_in);
+	glyph_purge(self);
+	self->glyph_hits = 0;
+	self->glyph_misses = 0;
+	return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(ili9342c_ILI9342C_glyph_cache_purge_obj, ili9342c_ILI9342C_glyph_cache_purge);
+
+
+static mp_obj_t ili9342c_ILI9342C_bitmap(size_t n_args, const mp_obj_t *args) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+
+	mp_obj_module_t *bitmap		 = MP_OBJ_TO_PTR(args[1]);
+	mp_int_t		 x			 = mp_obj_get_int(args[2]);
+	mp_int_t		 y			 = mp_obj_get_int(args[3]);
+
+    mp_int_t idx;
+    if (n_args > 3) {
+        idx = mp_obj_get_int(args[4]);
+    } else {
+        idx = 0;
+    }
+
+	mp_obj_dict_t *	 dict		 = MP_OBJ_TO_PTR(bitmap->globals);
+	const uint16_t	 height		 = mp_obj_get_int(mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_HEIGHT)));
+	const uint16_t	 width		 = mp_obj_get_int(mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_WIDTH)));
+	uint16_t         bitmaps     = 0;
+	const uint8_t	 bpp		 = mp_obj_get_int(mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_BPP)));
+	mp_obj_t *		 palette_arg = mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_PALETTE));
+	mp_obj_t *		 palette	 = NULL;
+	size_t			 palette_len = 0;
+
+	mp_map_elem_t *elem = dict_lookup(bitmap->globals, MP_OBJ_NEW_QSTR(MP_QSTR_BITMAPS));
+    if (elem) {
+        bitmaps = mp_obj_get_int(elem);
+    }
+
+	mp_obj_get_array(palette_arg, &palette_len, &palette);
+
+	mp_obj_t *		 bitmap_data_buff = mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_BITMAP));
+	mp_buffer_info_t bufinfo;
+
+	mp_get_buffer_raise(bitmap_data_buff, &bufinfo, MP_BUFFER_READ);
+
+	if (bpp < 1 || bpp > 8) {
+		mp_raise_ValueError(MP_ERROR_TEXT("BPP must be 1 to 8"));
+	}
+
+	uint16_t colors[256];
+	for (int i = 0; i < (1 << bpp); i++) {
+		colors[i] = ((size_t) i < palette_len) ? mp_obj_get_int(palette[i]) : 0;
+	}
+
+	uint32_t bit = 0;
+    if (bitmaps) {
+        if (idx < bitmaps ) {
+            bit = height * width * bpp * idx;
+        } else {
+            mp_raise_msg(&mp_type_OSError, MP_ERROR_TEXT("index out of range"));
+        }
+    }
+
+	uint32_t buf_size = width * height * 2;
+	if (self->buffer_size == 0) {
+		self->i2c_buffer = m_malloc(buf_size);
+	}
+
+	unpack_bits(bufinfo.buf, bit, bpp, colors, self->i2c_buffer, width * height);
+
+	uint16_t x1 = x + width - 1;
+	if (x1 < self->width) {
+		set_window(self, x, y, x1, y + height - 1);
+		write_data(self, (uint8_t *) self->i2c_buffer, buf_size);
+	}
+
+	if (self->buffer_size == 0) {
+		m_free(self->i2c_buffer);
+	}
+	queue_flush(self);
+	return mp_const_none;
+}
+
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_bitmap_obj, 4, 5, ili9342c_ILI9342C_bitmap);
+
+//
+// Sprites
+//
+// A Sprite holds its frames expanded to byte swapped RGB565 pixels, ready to
+// send, with an optional 1 bit mask of the opaque pixels. sprites() redraws
+// the area each changed sprite was last drawn in and the area it is drawn in
+// now, merged where they overlap. Each area is composited in bands of rows,
+// the background first and then every sprite over it in list order, so only
+// those areas are sent.
+//
+
+typedef struct _ili9342c_Sprite_obj_t {
+	mp_obj_base_t	base;
+	uint16_t	   *pixels;			// frames of width * height pixels
+	uint8_t		   *mask;			// opaque pixels, MSB first, NULL if none
+	uint32_t		mask_stride;	// mask bytes per frame, 0 if shared
+	uint16_t		width;
+	uint16_t		height;
+	uint16_t		frames;
+	uint16_t		frame;			// frame to draw
+	int16_t			x;				// position to draw at
+	int16_t			y;
+	bool			visible;
+	bool			changed;		// moved or changed since last drawn
+	bool			drawn;			// drawn_rect is on the display
+	ili9342c_rect_t drawn_rect;		// area last drawn, clipped to the display
+} ili9342c_Sprite_obj_t;
+
+// forward reference prototype
+static mp_obj_t ili9342c_Sprite_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *all_args);
+
+// expand the frames of a bitmap module into dst, returns the frames added
+static uint16_t sprite_expand(ili9342c_Sprite_obj_t *self, mp_obj_t bitmap_in, uint16_t *dst) {
+	mp_obj_module_t *bitmap = MP_OBJ_TO_PTR(bitmap_in);
+	mp_obj_dict_t	*dict	= MP_OBJ_TO_PTR(bitmap->globals);
+	const uint16_t	 height = mp_obj_get_int(mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_HEIGHT)));
+	const uint16_t	 width	= mp_obj_get_int(mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_WIDTH)));
+	const uint8_t	 bpp	= mp_obj_get_int(mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_BPP)));
+	uint16_t		 frames = 1;
+
+	mp_map_elem_t *elem = dict_lookup(bitmap->globals, MP_OBJ_NEW_QSTR(MP_QSTR_BITMAPS));
+	if (elem) {
+		frames = mp_obj_get_int(elem);
+	}
+
+	if (self->width == 0) {
+		self->width	 = width;
+		self->height = height;
+	} else if (width != self->width || height != self->height) {
+		mp_raise_ValueError(MP_ERROR_TEXT("frames must be the same size"));
+	}
+
+	if (dst == NULL) {
+		return frames;
+	}
+
+	size_t	  palette_len = 0;
+	mp_obj_t *palette	  = NULL;
+	mp_obj_get_array(mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_PALETTE)), &palette_len, &palette);
+	if (bpp < 1 || bpp > 8) {
+		mp_raise_ValueError(MP_ERROR_TEXT("BPP must be 1 to 8"));
+	}
+	uint16_t colors[256];
+	for (int i = 0; i < (1 << bpp); i++) {
+		colors[i] = ((size_t) i < palette_len) ? mp_obj_get_int(palette[i]) : 0;
+	}
+
+	mp_buffer_info_t bufinfo;
+	mp_get_buffer_raise(mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_BITMAP)), &bufinfo, MP_BUFFER_READ);
+	unpack_bits(bufinfo.buf, 0, bpp, colors, dst, (uint32_t) width * height * frames);
+	return frames;
+}
+
+static void ili9342c_Sprite_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind) {
+	(void) kind;
+	ili9342c_Sprite_obj_t *self = MP_OBJ_TO_PTR(self_in);
+	mp_printf(print, "<Sprite width=%u, height=%u, frames=%u>", self->width, self->height, self->frames);
+}
+
+static mp_obj_t ili9342c_Sprite_move(mp_obj_t self_in, mp_obj_t x_in, mp_obj_t y_in) {
+	ili9342c_Sprite_obj_t *self = MP_OBJ_TO_PTR(self_in);
+	self->x		  = mp_obj_get_int(x_in);
+	self->y		  = mp_obj_get_int(y_in);
+	self->changed = true;
+	return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_3(ili9342c_Sprite_move_obj, ili9342c_Sprite_move);
+
+static mp_obj_t ili9342c_Sprite_frame(size_t n_args, const mp_obj_t *args) {
+	ili9342c_Sprite_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+	if (n_args == 1) {
+		return mp_obj_new_int(self->frame);
+	}
+	mp_int_t frame = mp_obj_get_int(args[1]) % self->frames;
+	if (frame < 0) {
+		frame += self->frames;
+	}
+	if (frame != self->frame) {
+		self->frame	  = frame;
+		self->changed = true;
+	}
+	return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_Sprite_frame_obj, 1, 2, ili9342c_Sprite_frame);
+
+static mp_obj_t ili9342c_Sprite_visible(size_t n_args, const mp_obj_t *args) {
+	ili9342c_Sprite_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+	if (n_args == 1) {
+		return mp_obj_new_bool(self->visible);
+	}
+	bool visible = mp_obj_is_true(args[1]);
+	if (visible != self->visible) {
+		self->visible = visible;
+		self->changed = true;
+	}
+	return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_Sprite_visible_obj, 1, 2, ili9342c_Sprite_visible);
+
+static const mp_rom_map_elem_t ili9342c_Sprite_locals_dict_table[] = {
+	{MP_ROM_QSTR(MP_QSTR_move), MP_ROM_PTR(&ili9342c_Sprite_move_obj)},
+	{MP_ROM_QSTR(MP_QSTR_frame), MP_ROM_PTR(&ili9342c_Sprite_frame_obj)},
+	{MP_ROM_QSTR(MP_QSTR_visible), MP_ROM_PTR(&ili9342c_Sprite_visible_obj)},
+};
+static MP_DEFINE_CONST_DICT(ili9342c_Sprite_locals_dict, ili9342c_Sprite_locals_dict_table);
+
+#ifdef MP_OBJ_TYPE_GET_SLOT
+
+MP_DEFINE_CONST_OBJ_TYPE(
+    ili9342c_Sprite_type,
+    MP_QSTR_Sprite,
+    MP_TYPE_FLAG_NONE,
+    print, ili9342c_Sprite_print,
+    make_new, ili9342c_Sprite_make_new,
+    locals_dict, (mp_obj_dict_t *)&ili9342c_Sprite_locals_dict);
+
+#else
+
+const mp_obj_type_t ili9342c_Sprite_type = {
+	{&mp_type_type},
+	.name		 = MP_QSTR_Sprite,
+	.print		 = ili9342c_Sprite_print,
+	.make_new	 = ili9342c_Sprite_make_new,
+	.locals_dict = (mp_obj_dict_t *) &ili9342c_Sprite_locals_dict,
+};
+
+#endif
+
+static mp_obj_t ili9342c_Sprite_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *all_args) {
+	enum { ARG_bitmap, ARG_x, ARG_y, ARG_key, ARG_mask, ARG_width, ARG_height };
+	static const mp_arg_t allowed_args[] = {
+		{MP_QSTR_bitmap, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL}},
+		{MP_QSTR_x, MP_ARG_INT, {.u_int = 0}},
+		{MP_QSTR_y, MP_ARG_INT, {.u_int = 0}},
+		{MP_QSTR_key, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = -1}},
+		{MP_QSTR_mask, MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL}},
+		{MP_QSTR_width, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 0}},
+		{MP_QSTR_height, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 0}},
+	};
+	mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+	mp_arg_parse_all_kw_array(n_args, n_kw, all_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+	ili9342c_Sprite_obj_t *self = m_new_obj(ili9342c_Sprite_obj_t);
+	memset(self, 0, sizeof(*self));
+	self->base.type = &ili9342c_Sprite_type;
+	self->x			= args[ARG_x].u_int;
+	self->y			= args[ARG_y].u_int;
+	self->visible	= true;
+	self->changed	= true;
+
+	mp_obj_t  bitmap = args[ARG_bitmap].u_obj;
+	size_t	  count	 = 0;
+	mp_obj_t *items	 = NULL;
+	mp_buffer_info_t bufinfo;
+
+	if (mp_obj_is_type(bitmap, &mp_type_module)) {
+		count = 1;
+		items = &args[ARG_bitmap].u_obj;
+	} else if (mp_obj_is_type(bitmap, &mp_type_list) || mp_obj_is_type(bitmap, &mp_type_tuple)) {
+		mp_obj_get_array(bitmap, &count, &items);
+	}
+
+	if (count) {
+		// bitmap modules, or a list of them, one or more frames each
+		for (size_t i = 0; i < count; i++) {
+			self->frames += sprite_expand(self, items[i], NULL);
+		}
+		self->pixels = m_malloc(self->width * self->height * self->frames * 2);
+		uint16_t *dst = self->pixels;
+		for (size_t i = 0; i < count; i++) {
+			dst += sprite_expand(self, items[i], dst) * self->width * self->height;
+		}
+	} else {
+		// pixels in the same byte order as blit_buffer()
+		mp_get_buffer_raise(bitmap, &bufinfo, MP_BUFFER_READ);
+		self->width	 = args[ARG_width].u_int;
+		self->height = args[ARG_height].u_int;
+		if (self->width == 0 || self->height == 0) {
+			mp_raise_ValueError(MP_ERROR_TEXT("width and height required"));
+		}
+		self->frames = bufinfo.len / (self->width * self->height * 2);
+		if (self->frames == 0) {
+			mp_raise_ValueError(MP_ERROR_TEXT("buffer too small"));
+		}
+		self->pixels = m_malloc(self->width * self->height * self->frames * 2);
+		memcpy(self->pixels, bufinfo.buf, self->width * self->height * self->frames * 2);
+	}
+
+	uint32_t size		= self->width * self->height;
+	uint32_t mask_bytes = (size + 7) / 8;
+
+	if (args[ARG_mask].u_obj != MP_OBJ_NULL) {
+		// one mask for all the frames or one for each
+		mp_get_buffer_raise(args[ARG_mask].u_obj, &bufinfo, MP_BUFFER_READ);
+		if (bufinfo.len >= mask_bytes * self->frames) {
+			self->mask_stride = mask_bytes;
+		} else if (bufinfo.len < mask_bytes) {
+			mp_raise_ValueError(MP_ERROR_TEXT("mask too small"));
+		}
+		self->mask = m_malloc(self->mask_stride ? mask_bytes * self->frames : mask_bytes);
+		memcpy(self->mask, bufinfo.buf, self->mask_stride ? mask_bytes * self->frames : mask_bytes);
+	} else if (args[ARG_key].u_int >= 0) {
+		// build the mask from the transparent color
+		uint16_t key = _swap_bytes(args[ARG_key].u_int);
+		self->mask_stride = mask_bytes;
+		self->mask		  = m_malloc(mask_bytes * self->frames);
+		memset(self->mask, 0, mask_bytes * self->frames);
+		for (uint16_t f = 0; f < self->frames; f++) {
+			uint16_t *src  = self->pixels + f * size;
+			uint8_t	 *mask = self->mask + f * mask_bytes;
+			for (uint32_t i = 0; i < size; i++) {
+				if (src[i] != key) {
+					mask[i / 8] |= 0x80 >> (i % 8);
+				}
+			}
+		}
+	}
+
+	return MP_OBJ_FROM_PTR(self);
+}
+
+// area of the display the sprite covers, false if none
+static bool sprite_rect(ili9342c_ILI9342C_obj_t *self, ili9342c_Sprite_obj_t *sprite, ili9342c_rect_t *r) {
+	int x0 = MAX(sprite->x, 0);
+	int y0 = MAX(sprite->y, 0);
+	int x1 = MIN(sprite->x + sprite->width - 1, self->width - 1);
+	int y1 = MIN(sprite->y + sprite->height - 1, self->height - 1);
+
+	if (!sprite->visible || x0 > x1 || y0 > y1) {
+		return false;
+	}
+	*r = (ili9342c_rect_t) {x0, y0, x1, y1};
+	return true;
+}
+
+// add an area to redraw, merging it with any it overlaps
+static int sprite_area_add(ili9342c_rect_t *areas, int count, ili9342c_rect_t r) {
+	int i = 0;
+	while (i < count) {
+		ili9342c_rect_t *d = &areas[i];
+		if (r.x0 <= d->x1 && d->x0 <= r.x1 && r.y0 <= d->y1 && d->y0 <= r.y1) {
+			r.x0 = MIN(r.x0, d->x0);
+			r.y0 = MIN(r.y0, d->y0);
+			r.x1 = MAX(r.x1, d->x1);
+			r.y1 = MAX(r.y1, d->y1);
+			*d = areas[--count];
+			i = 0;
+		} else {
+			i++;
+		}
+	}
+	areas[count++] = r;
+	return count;
+}
+
+// composite the sprites over the background in area r, rows at a time
+static void sprites_draw(ili9342c_ILI9342C_obj_t *self, mp_obj_t *items, size_t count, ili9342c_rect_t r, uint16_t background, const uint16_t *bg_buffer, uint16_t *buf, uint32_t buf_pixels) {
+	uint16_t w	  = r.x1 - r.x0 + 1;
+	uint16_t rows = buf_pixels / w;
+
+	set_window(self, r.x0, r.y0, r.x1, r.y1);
+	for (uint16_t top = r.y0; top <= r.y1; top += rows) {
+		uint16_t bottom = MIN(top + rows - 1, r.y1);
+
+		for (uint16_t y = top; y <= bottom; y++) {
+			uint16_t *dst = buf + (y - top) * w;
+			if (bg_buffer) {
+				memcpy(dst, bg_buffer + y * self->width + r.x0, w * 2);
+			} else {
+				for (uint16_t i = 0; i < w; i++) {
+					dst[i] = background;
+				}
+			}
+		}
+
+		for (size_t n = 0; n < count; n++) {
+			ili9342c_Sprite_obj_t *sprite = MP_OBJ_TO_PTR(items[n]);
+			int x0 = MAX(sprite->x, r.x0);
+			int x1 = MIN(sprite->x + sprite->width - 1, r.x1);
+			int y0 = MAX(sprite->y, top);
+			int y1 = MIN(sprite->y + sprite->height - 1, bottom);
+			if (!sprite->visible || x0 > x1 || y0 > y1) {
+				continue;
+			}
+
+			uint32_t	   size	  = sprite->width * sprite->height;
+			const uint8_t *mask	  = sprite->mask ? sprite->mask + sprite->frame * sprite->mask_stride : NULL;
+			for (int y = y0; y <= y1; y++) {
+				uint32_t		ofs = (y - sprite->y) * sprite->width + (x0 - sprite->x);
+				const uint16_t *src = sprite->pixels + sprite->frame * size + ofs;
+				uint16_t	   *dst = buf + (y - top) * w + (x0 - r.x0);
+				if (mask == NULL) {
+					memcpy(dst, src, (x1 - x0 + 1) * 2);
+				} else {
+					for (int i = 0; i <= x1 - x0; i++, ofs++) {
+						if (mask[ofs / 8] & (0x80 >> (ofs % 8))) {
+							dst[i] = src[i];
+						}
+					}
+				}
+			}
+		}
+
+		write_data(self, (uint8_t *) buf, w * (bottom - top + 1) * 2);
+	}
+}
+
+static mp_obj_t ili9342c_ILI9342C_sprites(size_t n_args, const mp_obj_t *args) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+	size_t					 count;
+	mp_obj_t				*items;
+	uint16_t				 background = 0;
+	const uint16_t			*bg_buffer	= NULL;
+
+	mp_obj_get_array(args[1], &count, &items);
+	for (size_t i = 0; i < count; i++) {
+		if (!mp_obj_is_type(items[i], &ili9342c_Sprite_type)) {
+			mp_raise_TypeError(MP_ERROR_TEXT("expected Sprite"));
+		}
+	}
+
+	if (n_args > 2) {
+		if (mp_obj_is_int(args[2])) {
+			background = _swap_bytes(mp_obj_get_int(args[2]));
+		} else {
+			mp_buffer_info_t bufinfo;
+			mp_get_buffer_raise(args[2], &bufinfo, MP_BUFFER_READ);
+			if (bufinfo.len < (size_t) self->width * self->height * 2) {
+				mp_raise_ValueError(MP_ERROR_TEXT("background too small"));
+			}
+			bg_buffer = bufinfo.buf;
+		}
+	}
+
+	// the areas changed sprites left and moved to
+	ili9342c_rect_t *areas = m_malloc(sizeof(ili9342c_rect_t) * (count * 2 + 1));
+	int				 n	   = 0;
+	for (size_t i = 0; i < count; i++) {
+		ili9342c_Sprite_obj_t *sprite = MP_OBJ_TO_PTR(items[i]);
+		ili9342c_rect_t		   r;
+		if (!sprite->changed) {
+			continue;
+		}
+		if (sprite->drawn) {
+			n = sprite_area_add(areas, n, sprite->drawn_rect);
+		}
+		sprite->drawn = sprite_rect(self, sprite, &r);
+		if (sprite->drawn) {
+			sprite->drawn_rect = r;
+			n = sprite_area_add(areas, n, r);
+		}
+		sprite->changed = false;
+	}
+
+	if (n) {
+		uint16_t *buf = self->i2c_buffer;
+		uint32_t  buf_pixels = self->buffer_size / 2;
+		if (buf_pixels < self->width) {
+			buf_pixels = self->width * ILI9342C_BAND_HEIGHT;
+			buf = m_malloc(buf_pixels * 2);
+		}
+		for (int i = 0; i < n; i++) {
+			sprites_draw(self, items, count, areas[i], background, bg_buffer, buf, buf_pixels);
+		}
+		if (buf != self->i2c_buffer) {
+			m_free(buf);
+		}
+	}
+	m_free(areas);
+	queue_flush(self);
+
+	return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_sprites_obj, 2, 3, ili9342c_ILI9342C_sprites);
+
+static mp_obj_t ili9342c_ILI9342C_text(size_t n_args, const mp_obj_t *args) {
+	char		single_char_s[2] = {0, 0};
+	const char *str;
+
+	// extract arguments
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+	ili9342c_Font_obj_t		 tmp;
+	const ili9342c_Font_obj_t *font = font_get(args[1], FONT_TEXT, &tmp);
+
+	if (mp_obj_is_int(args[2])) {
+		mp_int_t c		 = mp_obj_get_int(args[2]);
+		single_char_s[0] = c & 0xff;
+		str				 = single_char_s;
+	} else {
+		str = mp_obj_str_get_str(args[2]);
+	}
+
+	mp_int_t x0 = mp_obj_get_int(args[3]);
+	mp_int_t y0 = mp_obj_get_int(args[4]);
+
+	const uint8_t  width	 = font->width;
+	const uint8_t  height	 = font->height;
+	const uint8_t  first	 = font->first;
+	const uint8_t  last		 = font->last;
+	const uint8_t *font_data = font->data;
+
+	mp_int_t fg_color;
+	mp_int_t bg_color;
+
+	if (n_args > 5)
+		fg_color = _swap_bytes(mp_obj_get_int(args[5]));
+	else
+		fg_color = _swap_bytes(WHITE);
+
+	if (n_args > 6)
+		bg_color = _swap_bytes(mp_obj_get_int(args[6]));
+	else
+		bg_color = _swap_bytes(BLACK);
+
+	uint8_t	 wide	  = width / 8;
+	uint16_t buf_size = width * height * 2;
+
+	if (self->buffer_size == 0) {
+		self->i2c_buffer = m_malloc(buf_size);
+	}
+
+	if (self->i2c_buffer) {
+		uint8_t chr;
+		while ((chr = *str++)) {
+			if (chr >= first && chr <= last) {
+				uint16_t buf_idx = 0;
+				uint16_t chr_idx = (chr - first) * (height * wide);
+				for (uint8_t line = 0; line < height; line++) {
+					for (uint8_t line_byte = 0; line_byte < wide; line_byte++) {
+						uint8_t chr_data = font_data[chr_idx];
+						for (uint8_t bit = 8; bit; bit--) {
+							if (chr_data >> (bit - 1) & 1)
+								self->i2c_buffer[buf_idx] = fg_color;
+							else
+								self->i2c_buffer[buf_idx] = bg_color;
+							buf_idx++;
+						}
+						chr_idx++;
+					}
+				}
+				uint16_t x1 = x0 + width - 1;
+				if (x1 < self->width) {
+					set_window(self, x0, y0, x1, y0 + height - 1);
+					write_data(self, (uint8_t *) self->i2c_buffer, buf_size);
 				}
+				x0 += width;
 			}
+		}
+		if (self->buffer_size == 0) {
+			m_free(self->i2c_buffer);
+		}
+	}
+	queue_flush(self);
+	return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_text_obj, 5, 7, ili9342c_ILI9342C_text);
+
+static void set_rotation(ili9342c_ILI9342C_obj_t *self) {
+	uint8_t madctl_value = ILI9342C_MADCTL_RGB;
+
+	// the display list was recorded for the old rotation
+	if (self->display_list) {
+		bands_show(self);
+	}
+
+	if (self->rotation == 0) { // Portrait
+		self->width	 = self->display_width;
+		self->height = self->display_height;
+	} else if (self->rotation == 1) { // Landscape
+		madctl_value |= ILI9342C_MADCTL_MX | ILI9342C_MADCTL_MV;
+		self->width	 = self->display_height;
+		self->height = self->display_width;
+	} else if (self->rotation == 2) { // Inverted Portrait
+		madctl_value |= ILI9342C_MADCTL_MX | ILI9342C_MADCTL_MY;
+		self->width	 = self->display_width;
+		self->height = self->display_height;
+	} else if (self->rotation == 3) { // Inverted Landscape
+		madctl_value |= ILI9342C_MADCTL_MV | ILI9342C_MADCTL_MY;
+		self->width	 = self->display_height;
+		self->height = self->display_width;
+	} else if (self->rotation == 4) { // Portrait Mirrored
+		madctl_value |= ILI9342C_MADCTL_MX;
+		self->width	 = self->display_width;
+		self->height = self->display_height;
+	} else if (self->rotation == 5) { // Landscape Mirrored
+		madctl_value |=  ILI9342C_MADCTL_MV;
+		self->width	 = self->display_height;
+		self->height = self->display_width;
+	} else if (self->rotation == 6) { // Inverted Portrait Mirrored
+		madctl_value |= ILI9342C_MADCTL_MY;
+		self->width	 = self->display_width;
+		self->height = self->display_height;
+	} else if (self->rotation == 7) { // Inverted Landscape Mirrored
+		madctl_value |= ILI9342C_MADCTL_MX | ILI9342C_MADCTL_MY | ILI9342C_MADCTL_MV;
+		self->width	 = self->display_height;
+		self->height = self->display_width;
+	}
+
+	const uint8_t madctl[] = {madctl_value};
+	write_cmd(self, ILI9342C_MADCTL, madctl, 1);
+	window_invalidate(self);
+
+	// the frame buffer is laid out in logical coordinates, so all of it changed
+	if (self->frame_buffer) {
+		self->dirty_count = 0;
+		dirty_add(self, 0, 0, self->width - 1, self->height - 1);
+	}
+}
+
+
+static mp_obj_t ili9342c_ILI9342C_rotation(mp_obj_t self_in, mp_obj_t value) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(self_in);
+
+	mp_int_t rotation = mp_obj_get_int(value) % 8;
+	self->rotation	  = rotation;
+	set_rotation(self);
+	queue_flush(self);
+	return mp_const_none;
+}
+
+MP_DEFINE_CONST_FUN_OBJ_2(ili9342c_ILI9342C_rotation_obj, ili9342c_ILI9342C_rotation);
+
+
+static mp_obj_t ili9342c_ILI9342C_width(mp_obj_t self_in) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(self_in);
+	return mp_obj_new_int(self->width);
+}
+
+MP_DEFINE_CONST_FUN_OBJ_1(ili9342c_ILI9342C_width_obj, ili9342c_ILI9342C_width);
+
+static mp_obj_t ili9342c_ILI9342C_height(mp_obj_t self_in) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(self_in);
+	return mp_obj_new_int(self->height);
+}
+
+MP_DEFINE_CONST_FUN_OBJ_1(ili9342c_ILI9342C_height_obj, ili9342c_ILI9342C_height);
+
+static mp_obj_t ili9342c_ILI9342C_vscrdef(size_t n_args, const mp_obj_t *args) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+
+	mp_int_t tfa = mp_obj_get_int(args[1]);
+	mp_int_t vsa = mp_obj_get_int(args[2]);
+	mp_int_t bfa = mp_obj_get_int(args[3]);
+
+	uint8_t buf[6] = {(tfa) >> 8, (tfa) &0xFF, (vsa) >> 8, (vsa) &0xFF, (bfa) >> 8, (bfa) &0xFF};
+	write_cmd(self, ILI9342C_VSCRDEF, buf, 6);
+	queue_flush(self);
+
+	return mp_const_none;
+}
+
+MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_vscrdef_obj, 4, 4, ili9342c_ILI9342C_vscrdef);
+
+static mp_obj_t ili9342c_ILI9342C_vscsad(mp_obj_t self_in, mp_obj_t vssa_in) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(self_in);
+
+	mp_int_t vssa	= mp_obj_get_int(vssa_in);
+	uint8_t	 buf[2] = {(vssa) >> 8, (vssa) &0xFF};
+	write_cmd(self, ILI9342C_VSCSAD, buf, 2);
+	queue_flush(self);
+
+	return mp_const_none;
+}
+
+MP_DEFINE_CONST_FUN_OBJ_2(ili9342c_ILI9342C_vscsad_obj, ili9342c_ILI9342C_vscsad);
+
+static mp_obj_t ili9342c_ILI9342C_init(mp_obj_t self_in) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(self_in);
+	ili9342c_ILI9342C_hard_reset(self_in);
+	ili9342c_ILI9342C_soft_reset(self_in);
+	write_cmd(self, ILI9342C_SLPOUT, NULL, 0);
+
+	const uint8_t color_mode[] = {COLOR_MODE_65K | COLOR_MODE_16BIT};
+	write_cmd(self, ILI9342C_COLMOD, color_mode, 1);
+	queue_flush(self);
+	mp_hal_delay_ms(10);
+
+	set_rotation(self);
+
+	write_cmd(self, ILI9342C_INVON, NULL, 0);
+	queue_flush(self);
+	mp_hal_delay_ms(10);
+	write_cmd(self, ILI9342C_NORON, NULL, 0);
+	queue_flush(self);
+	mp_hal_delay_ms(10);
+
+	const mp_obj_t args[] = {
+		self_in,
+		mp_obj_new_int(0),
+		mp_obj_new_int(0),
+		mp_obj_new_int(self->width),
+		mp_obj_new_int(self->height),
+		mp_obj_new_int(BLACK)};
+	ili9342c_ILI9342C_fill_rect(6, args);
+	show(self);
+
+	if (self->backlight)
+		mp_hal_pin_write(self->backlight, 1);
+
+	write_cmd(self, ILI9342C_DISPON, NULL, 0);
+	queue_flush(self);
+	mp_hal_delay_ms(500);
+
+	return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_1(ili9342c_ILI9342C_init_obj, ili9342c_ILI9342C_init);
 
-			uint32_t data_size = width * height * 2;
-			uint16_t x1 = x + width - 1;
-			if (x1 < self->width) {
-				set_window(self, x, y, x1, y + height - 1);
-				DC_HIGH();
-				CS_LOW();
-				write_spi(self->spi_obj, (uint8_t *) self->i2c_buffer, data_size);
-				CS_HIGH();
-				print_width += width;
+static mp_obj_t ili9342c_ILI9342C_hline(size_t n_args, const mp_obj_t *args) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+
+	mp_int_t x	   = mp_obj_get_int(args[1]);
+	mp_int_t y	   = mp_obj_get_int(args[2]);
+	mp_int_t w	   = mp_obj_get_int(args[3]);
+	mp_int_t color = mp_obj_get_int(args[4]);
+
+	fast_hline(self, x, y, w, color);
+	queue_flush(self);
+
+	return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_hline_obj, 5, 5, ili9342c_ILI9342C_hline);
+
+static mp_obj_t ili9342c_ILI9342C_vline(size_t n_args, const mp_obj_t *args) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+
+	mp_int_t x	   = mp_obj_get_int(args[1]);
+	mp_int_t y	   = mp_obj_get_int(args[2]);
+	mp_int_t w	   = mp_obj_get_int(args[3]);
+	mp_int_t color = mp_obj_get_int(args[4]);
+
+	fast_vline(self, x, y, w, color);
+	queue_flush(self);
+
+	return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_vline_obj, 5, 5, ili9342c_ILI9342C_vline);
+
+static mp_obj_t ili9342c_ILI9342C_rect(size_t n_args, const mp_obj_t *args) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+
+	mp_int_t x	   = mp_obj_get_int(args[1]);
+	mp_int_t y	   = mp_obj_get_int(args[2]);
+	mp_int_t w	   = mp_obj_get_int(args[3]);
+	mp_int_t h	   = mp_obj_get_int(args[4]);
+	mp_int_t color = mp_obj_get_int(args[5]);
+
+	fast_hline(self, x, y, w, color);
+	fast_vline(self, x, y, h, color);
+	fast_hline(self, x, y + h - 1, w, color);
+	fast_vline(self, x + w - 1, y, h, color);
+	queue_flush(self);
+	return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_rect_obj, 6, 6, ili9342c_ILI9342C_rect);
+
+static uint16_t color565(uint8_t r, uint8_t g, uint8_t b) {
+	return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | ((b & 0xF8) >> 3);
+}
+
+static mp_obj_t ili9342c_color565(mp_obj_t r, mp_obj_t g, mp_obj_t b) {
+	return MP_OBJ_NEW_SMALL_INT(color565(
+		(uint8_t) mp_obj_get_int(r),
+		(uint8_t) mp_obj_get_int(g),
+		(uint8_t) mp_obj_get_int(b)));
+}
+static MP_DEFINE_CONST_FUN_OBJ_3(ili9342c_color565_obj, ili9342c_color565);
+
+//
+//	load_font(module) returns a Font for text(), write(), write_len() or draw()
+//
+
+static mp_obj_t ili9342c_load_font(mp_obj_t module_in) {
+	if (!mp_obj_is_type(module_in, &mp_type_module)) {
+		mp_raise_TypeError(MP_ERROR_TEXT("expected font module"));
+	}
+	mp_obj_module_t *module = MP_OBJ_TO_PTR(module_in);
+	uint8_t			 kind	= FONT_TEXT;
+
+	if (dict_lookup(module->globals, MP_OBJ_NEW_QSTR(MP_QSTR_MAP))) {
+		kind = FONT_WRITE;
+	} else if (dict_lookup(module->globals, MP_OBJ_NEW_QSTR(MP_QSTR_INDEX))) {
+		kind = FONT_HERSHEY;
+	}
+
+	ili9342c_Font_obj_t *font = m_new_obj(ili9342c_Font_obj_t);
+	memset(font, 0, sizeof(*font));
+	font->base.type = &ili9342c_Font_type;
+	font_load(font, module_in, kind);
+
+	if (kind == FONT_WRITE) {
+		// the first glyph for each byte, as strchr() would find
+		uint16_t *map_index = m_malloc(256 * sizeof(uint16_t));
+		for (int i = 0; i < 256; i++) {
+			map_index[i] = GLYPH_NONE;
+		}
+		for (uint16_t i = 0; font->map[i]; i++) {
+			uint8_t chr = font->map[i];
+			if (map_index[chr] == GLYPH_NONE) {
+				map_index[chr] = i;
 			}
-			else
-				break;
+		}
+		font->map_index = map_index;
+	}
 
-			x += width;
+	return MP_OBJ_FROM_PTR(font);
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(ili9342c_load_font_obj, ili9342c_load_font);
+
+#ifdef ILI9342C_MOCK_SPI
+
+//
+//	unpack(buffer, bpp, count[, reference]) expands count pixels of bpp bits
+//	from buffer to their values as 16 bit integers, with unpack_bits() or the
+//	bit at a time reference it replaced, for examples/UNIX/unpack.py
+//
+
+// bit at a time unpacking, as done by get_color() before unpack_bits()
+static void unpack_bits_reference(const uint8_t *src, uint32_t bit, uint8_t bpp, const uint16_t *colors, uint16_t *dst, uint32_t count) {
+	while (count--) {
+		uint8_t color = 0;
+		for (int i = 0; i < bpp; i++) {
+			color <<= 1;
+			color |= (src[bit / 8] & 1 << (7 - (bit % 8))) > 0;
+			bit++;
 		}
+		*dst++ = colors[color];
 	}
+}
 
-	if (self->buffer_size == 0) {
-		m_free(self->i2c_buffer);
+static mp_obj_t ili9342c_unpack(size_t n_args, const mp_obj_t *args) {
+	mp_buffer_info_t bufinfo;
+	mp_get_buffer_raise(args[0], &bufinfo, MP_BUFFER_READ);
+	mp_int_t bpp	   = mp_obj_get_int(args[1]);
+	mp_int_t count	   = mp_obj_get_int(args[2]);
+	bool	 reference = (n_args > 3) && mp_obj_is_true(args[3]);
+
+	if (bpp < 1 || bpp > 8) {
+		mp_raise_ValueError(MP_ERROR_TEXT("bpp must be 1 to 8"));
+	}
+	if (count < 0 || (size_t) (count * bpp + 7) / 8 > bufinfo.len) {
+		mp_raise_ValueError(MP_ERROR_TEXT("buffer too small"));
 	}
 
-	return mp_obj_new_int(print_width);
+	uint16_t colors[256];
+	for (int i = 0; i < 256; i++) {
+		colors[i] = i;
+	}
+
+	uint16_t *pixels = m_malloc(count * 2);
+	if (reference) {
+		unpack_bits_reference(bufinfo.buf, 0, bpp, colors, pixels, count);
+	} else {
+		unpack_bits(bufinfo.buf, 0, bpp, colors, pixels, count);
+	}
+	mp_obj_t result = mp_obj_new_bytes((const uint8_t *) pixels, count * 2);
+	m_free(pixels);
+	return result;
 }
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_unpack_obj, 3, 4, ili9342c_unpack);
 
-static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_write_obj, 5, 7, ili9342c_ILI9342C_write);
+#endif
 
+static void map_bitarray_to_rgb565(uint8_t const *bitarray, uint8_t *buffer, int length, int width, uint16_t color, uint16_t bg_color) {
+	int row_pos = 0;
+	for (int i = 0; i < length; i++) {
+		uint8_t byte = bitarray[i];
+		for (int bi = 7; bi >= 0; bi--) {
+			uint8_t	 b		   = byte & (1 << bi);
+			uint16_t cur_color = b ? color : bg_color;
+			*buffer			   = (cur_color & 0xff00) >> 8;
+			buffer++;
+			*buffer = cur_color & 0xff;
+			buffer++;
 
-static mp_obj_t ili9342c_ILI9342C_bitmap(size_t n_args, const mp_obj_t *args) {
-	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+			row_pos++;
+			if (row_pos >= width) {
+				row_pos = 0;
+				break;
+			}
+		}
+	}
+}
 
-	mp_obj_module_t *bitmap		 = MP_OBJ_TO_PTR(args[1]);
-	mp_int_t		 x			 = mp_obj_get_int(args[2]);
-	mp_int_t		 y			 = mp_obj_get_int(args[3]);
+// bitarray buffer width color bg_color
 
-    mp_int_t idx;
-    if (n_args > 3) {
-        idx = mp_obj_get_int(args[4]);
-    } else {
-        idx = 0;
-    }
+static mp_obj_t ili9342c_map_bitarray_to_rgb565(size_t n_args, const mp_obj_t *args) {
+	mp_buffer_info_t bitarray_info;
+	mp_buffer_info_t buffer_info;
 
-	mp_obj_dict_t *	 dict		 = MP_OBJ_TO_PTR(bitmap->globals);
-	const uint16_t	 height		 = mp_obj_get_int(mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_HEIGHT)));
-	const uint16_t	 width		 = mp_obj_get_int(mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_WIDTH)));
-	uint16_t         bitmaps     = 0;
-	const uint8_t	 bpp		 = mp_obj_get_int(mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_BPP)));
-	mp_obj_t *		 palette_arg = mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_PALETTE));
-	mp_obj_t *		 palette	 = NULL;
-	size_t			 palette_len = 0;
+	mp_get_buffer_raise(args[1], &bitarray_info, MP_BUFFER_READ);
+	mp_get_buffer_raise(args[2], &buffer_info, MP_BUFFER_WRITE);
+	mp_int_t width	  = mp_obj_get_int(args[3]);
+	mp_int_t color	  = mp_obj_get_int(args[4]);
+	mp_int_t bg_color = mp_obj_get_int(args[5]);
+	map_bitarray_to_rgb565(bitarray_info.buf, buffer_info.buf, bitarray_info.len, width, color, bg_color);
+	return mp_const_none;
+}
 
-	mp_map_elem_t *elem = dict_lookup(bitmap->globals, MP_OBJ_NEW_QSTR(MP_QSTR_BITMAPS));
-    if (elem) {
-        bitmaps = mp_obj_get_int(elem);
-    }
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_map_bitarray_to_rgb565_obj, 3, 6, ili9342c_map_bitarray_to_rgb565);
 
-	mp_obj_get_array(palette_arg, &palette_len, &palette);
+//
+// jpg routines
+//
 
-	mp_obj_t *		 bitmap_data_buff = mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_BITMAP));
-	mp_buffer_info_t bufinfo;
+#define JPG_MODE_FAST (0)
+#define JPG_MODE_SLOW (1)
+#define JPG_MODE_STRIP (2)
 
-	mp_get_buffer_raise(bitmap_data_buff, &bufinfo, MP_BUFFER_READ);
-	bitmap_data = bufinfo.buf;
+// work area for the decoder's tables and MCU buffers, less the input buffer
+#define JPG_WORK_SIZE (3100 - JD_SZBUF + JD_SZLUT)
 
-	uint32_t buf_size = width * height * 2;
-	if (self->buffer_size == 0) {
-		self->i2c_buffer = m_malloc(buf_size);
+// User defined device identifier
+typedef struct {
+    mp_file_t *fp;          		// File pointer for input function
+	const uint8_t *data;			// jpg in memory, or NULL
+	size_t data_len;				// length of data
+	size_t data_pos;				// next byte of data to read
+	uint8_t *ahead;					// read ahead buffer for fp, or NULL
+	size_t ahead_size;				// size of the read ahead buffer
+	size_t ahead_len;				// bytes read into the read ahead buffer
+	size_t ahead_pos;				// next byte of the read ahead buffer
+    uint8_t *fbuf;          		// Pointer to the frame buffer for output function
+    unsigned int wfbuf;     		// Width of the frame buffer [pix]
+	ili9342c_ILI9342C_obj_t *self;	// display object
+	JRECT clip;						// part of the scaled image drawn
+	mp_int_t x, y;					// display position of the scaled image's top left
+	uint16_t strip_top;				// image row of the strip in fbuf
+	uint16_t strip_rows;			// rows in the strip, 0 if empty
+} IODEV;
+
+//
+// User defined input function
+//
+
+static unsigned int in_func(    // Returns number of bytes read (zero on error)
+    JDEC* jd,                   // Decompression object
+    uint8_t* buff,              // Pointer to the read buffer (null to remove data)
+    unsigned int nbyte )        // Number of bytes to read/remove
+{
+    IODEV *dev = (IODEV*)jd->device;   // Device identifier for the session (5th argument of jd_prepare function)
+	unsigned int nread;
+
+	if (dev->data) {			// in memory, copy or skip straight from the buffer
+		nread = MIN(nbyte, dev->data_len - dev->data_pos);
+		if (buff) {
+			memcpy(buff, dev->data + dev->data_pos, nread);
+		}
+		dev->data_pos += nread;
+		return nread;
 	}
 
-	uint32_t ofs = 0;
-    bs_bit = 0;
-    if (bitmaps) {
-        if (idx < bitmaps ) {
-            bs_bit = height * width * bpp * idx;
-        } else {
-            mp_raise_msg(&mp_type_OSError, MP_ERROR_TEXT("index out of range"));
-        }
+	if (dev->ahead) {			// copy or skip from the read ahead buffer, refilling it in blocks
+		nread = 0;
+		while (nread < nbyte) {
+			if (dev->ahead_pos == dev->ahead_len) {
+				dev->ahead_len = mp_readinto(dev->fp, dev->ahead, dev->ahead_size);
+				dev->ahead_pos = 0;
+				if (dev->ahead_len == 0) {
+					break;
+				}
+			}
+			size_t len = MIN(nbyte - nread, dev->ahead_len - dev->ahead_pos);
+			if (buff) {
+				memcpy(buff + nread, dev->ahead + dev->ahead_pos, len);
+			}
+			dev->ahead_pos += len;
+			nread += len;
+		}
+		return nread;
+	}
+
+    if (buff) { // Read data from input stream
+        nread = (unsigned int)mp_readinto(dev->fp, buff, nbyte);
+		return nread;
     }
 
-	for (int yy = 0; yy < height; yy++) {
-		for (int xx = 0; xx < width; xx++) {
-			self->i2c_buffer[ofs++] = mp_obj_get_int(palette[get_color(bpp + 1)]);
+    // Remove data from input stream if buff was NULL, reading it so streams
+    // that can not seek, like sockets, can be skipped too
+	uint8_t skip[64];
+	while (nbyte) {
+		nread = (unsigned int)mp_readinto(dev->fp, skip, MIN(nbyte, sizeof(skip)));
+		if (nread == 0) {
+			break;
 		}
+		nbyte -= nread;
 	}
+    return 0;
+}
 
-	uint16_t x1 = x + width - 1;
-	if (x1 < self->width) {
-		set_window(self, x, y, x1, y + height - 1);
-		DC_HIGH();
-		CS_LOW();
-		write_spi(self->spi_obj, (uint8_t *) self->i2c_buffer, buf_size);
-		CS_HIGH();
-	}
+//
+// In place input function for jpgs in memory, points the decoder at the rest
+// of the buffer instead of copying it into the read buffer
+//
 
-	if (self->buffer_size == 0) {
-		m_free(self->i2c_buffer);
+static unsigned int in_ref(JDEC* jd, uint8_t** buff) {
+	IODEV *dev = (IODEV*)jd->device;
+	unsigned int nread = (unsigned int)MIN(dev->data_len - dev->data_pos, UINT_MAX);
+
+	*buff = (uint8_t *)dev->data + dev->data_pos;
+	dev->data_pos += nread;
+	return nread;
+}
+
+//
+// Clip an MCU to the part of the image that is drawn, returns false if none of
+// it is
+//
+
+static bool out_clip(IODEV *dev, JRECT *rect, JRECT *r) {
+	r->left	  = MAX(rect->left, dev->clip.left);
+	r->right  = MIN(rect->right, dev->clip.right);
+	r->top	  = MAX(rect->top, dev->clip.top);
+	r->bottom = MIN(rect->bottom, dev->clip.bottom);
+	return r->left <= r->right && r->top <= r->bottom;
+}
+
+// copy the clipped part r of an MCU to dst, stride pixels a row
+static void out_copy(void *bitmap, JRECT *rect, JRECT *r, uint8_t *dst, unsigned int stride) {
+	unsigned int bws = 2 * (rect->right - rect->left + 1);
+	unsigned int len = 2 * (r->right - r->left + 1);
+	uint8_t *src = (uint8_t *) bitmap + (r->top - rect->top) * bws + 2 * (r->left - rect->left);
+
+	for (uint16_t y = r->top; y <= r->bottom; y++) {
+		memcpy(dst, src, len);
+		src += bws;
+		dst += 2 * stride;
 	}
-	return mp_const_none;
 }
 
-static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_bitmap_obj, 4, 5, ili9342c_ILI9342C_bitmap);
+//
+// User defined output function
+//
 
-static mp_obj_t ili9342c_ILI9342C_text(size_t n_args, const mp_obj_t *args) {
-	char		single_char_s[2] = {0, 0};
-	const char *str;
+static int out_fast (       // 1:Ok, 0:Aborted
+    JDEC* jd,               // Decompression object
+    void* bitmap,           // Bitmap data to be output
+    JRECT* rect )           // Rectangular region of output image
+{
+    IODEV *dev = (IODEV*)jd->device;
+	JRECT r;
 
-	// extract arguments
-	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
-	mp_obj_module_t *		 font = MP_OBJ_TO_PTR(args[1]);
+	// Copy the visible part of the decompressed RGB rectanglar to the frame buffer (assuming RGB565)
+	if (out_clip(dev, rect, &r)) {
+		out_copy(bitmap, rect, &r, dev->fbuf + 2 * ((r.top - dev->clip.top) * dev->wfbuf + r.left - dev->clip.left), dev->wfbuf);
+	}
 
-	if (mp_obj_is_int(args[2])) {
-		mp_int_t c		 = mp_obj_get_int(args[2]);
-		single_char_s[0] = c & 0xff;
-		str				 = single_char_s;
-	} else {
-		str = mp_obj_str_get_str(args[2]);
+    return 1;    // Continue to decompress
+}
+
+//
+// User defined output function
+//
+
+static int out_slow (       // 1:Ok, 0:Aborted
+    JDEC* jd,               // Decompression object
+    void* bitmap,           // Bitmap data to be output
+    JRECT* rect )           // Rectangular region of output image
+{
+	IODEV *dev = (IODEV*)jd->device;
+    ili9342c_ILI9342C_obj_t *self = dev->self;
+	JRECT r;
+
+	// if none of the rect is visible then return
+	if (!out_clip(dev, rect, &r)) {
+		return 1;
 	}
 
-	mp_int_t x0 = mp_obj_get_int(args[3]);
-	mp_int_t y0 = mp_obj_get_int(args[4]);
+    // Copy the visible part of the decompressed RGB rectanglar to the frame buffer (assuming RGB565)
+	out_copy(bitmap, rect, &r, dev->fbuf, r.right - r.left + 1);
 
-	mp_obj_dict_t *dict			  = MP_OBJ_TO_PTR(font->globals);
-	const uint8_t  width		  = mp_obj_get_int(mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_WIDTH)));
-	const uint8_t  height		  = mp_obj_get_int(mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_HEIGHT)));
-	const uint8_t  first		  = mp_obj_get_int(mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_FIRST)));
-	const uint8_t  last			  = mp_obj_get_int(mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_LAST)));
-	mp_obj_t	   font_data_buff = mp_obj_dict_get(dict, MP_OBJ_NEW_QSTR(MP_QSTR_FONT));
+	// blit buffer to display
 
-	mp_buffer_info_t bufinfo;
-	mp_get_buffer_raise(font_data_buff, &bufinfo, MP_BUFFER_READ);
-	const uint8_t *font_data = bufinfo.buf;
+    set_window(
+        self,
+        r.left + dev->x,
+        r.top + dev->y,
+        r.right + dev->x,
+        r.bottom + dev->y);
 
-	mp_int_t fg_color;
-	mp_int_t bg_color;
+	write_data(self, (uint8_t *) dev->fbuf, 2 * (r.right - r.left + 1) * (r.bottom - r.top + 1));
+	queue_flush(self);					// the next read may share the SPI bus
 
-	if (n_args > 5)
-		fg_color = _swap_bytes(mp_obj_get_int(args[5]));
-	else
-		fg_color = _swap_bytes(WHITE);
+    return 1;    // Continue to decompress
+}
 
-	if (n_args > 6)
-		bg_color = _swap_bytes(mp_obj_get_int(args[6]));
-	else
-		bg_color = _swap_bytes(BLACK);
+//
+// Strip output, the visible part of a row of MCUs is collected in the frame
+// buffer and sent with a single window when the next row starts
+//
 
-	uint8_t	 wide	  = width / 8;
-	uint16_t buf_size = width * height * 2;
+static void strip_flush(IODEV *dev) {
+    ili9342c_ILI9342C_obj_t *self = dev->self;
 
-	if (self->buffer_size == 0) {
-		self->i2c_buffer = m_malloc(buf_size);
-	}
+	if (dev->strip_rows) {
+		set_window(
+			self,
+			dev->clip.left + dev->x,
+			dev->strip_top + dev->y,
+			dev->clip.right + dev->x,
+			dev->strip_top + dev->strip_rows - 1 + dev->y);
 
-	if (self->i2c_buffer) {
-		uint8_t chr;
-		while ((chr = *str++)) {
-			if (chr >= first && chr <= last) {
-				uint16_t buf_idx = 0;
-				uint16_t chr_idx = (chr - first) * (height * wide);
-				for (uint8_t line = 0; line < height; line++) {
-					for (uint8_t line_byte = 0; line_byte < wide; line_byte++) {
-						uint8_t chr_data = font_data[chr_idx];
-						for (uint8_t bit = 8; bit; bit--) {
-							if (chr_data >> (bit - 1) & 1)
-								self->i2c_buffer[buf_idx] = fg_color;
-							else
-								self->i2c_buffer[buf_idx] = bg_color;
-							buf_idx++;
-						}
-						chr_idx++;
-					}
-				}
-				uint16_t x1 = x0 + width - 1;
-				if (x1 < self->width) {
-					set_window(self, x0, y0, x1, y0 + height - 1);
-					DC_HIGH();
-					CS_LOW();
-					write_spi(self->spi_obj, (uint8_t *) self->i2c_buffer, buf_size);
-					CS_HIGH();
-				}
-				x0 += width;
-			}
-		}
-		if (self->buffer_size == 0) {
-			m_free(self->i2c_buffer);
-		}
+		write_data(self, dev->fbuf, 2 * dev->wfbuf * dev->strip_rows);
+		queue_flush(self);				// the next read may share the SPI bus
 	}
-	return mp_const_none;
+	dev->strip_rows = 0;
 }
-static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_text_obj, 5, 7, ili9342c_ILI9342C_text);
 
-static void set_rotation(ili9342c_ILI9342C_obj_t *self) {
-	uint8_t madctl_value = ILI9342C_MADCTL_RGB;
+static int out_strip (      // 1:Ok, 0:Aborted
+    JDEC* jd,               // Decompression object
+    void* bitmap,           // Bitmap data to be output
+    JRECT* rect )           // Rectangular region of output image
+{
+	IODEV *dev = (IODEV*)jd->device;
+	JRECT r;
 
-	if (self->rotation == 0) { // Portrait
-		self->width	 = self->display_width;
-		self->height = self->display_height;
-	} else if (self->rotation == 1) { // Landscape
-		madctl_value |= ILI9342C_MADCTL_MX | ILI9342C_MADCTL_MV;
-		self->width	 = self->display_height;
-		self->height = self->display_width;
-	} else if (self->rotation == 2) { // Inverted Portrait
-		madctl_value |= ILI9342C_MADCTL_MX | ILI9342C_MADCTL_MY;
-		self->width	 = self->display_width;
-		self->height = self->display_height;
-	} else if (self->rotation == 3) { // Inverted Landscape
-		madctl_value |= ILI9342C_MADCTL_MV | ILI9342C_MADCTL_MY;
-		self->width	 = self->display_height;
-		self->height = self->display_width;
-	} else if (self->rotation == 4) { // Portrait Mirrored
-		madctl_value |= ILI9342C_MADCTL_MX;
-		self->width	 = self->display_width;
-		self->height = self->display_height;
-	} else if (self->rotation == 5) { // Landscape Mirrored
-		madctl_value |=  ILI9342C_MADCTL_MV;
-		self->width	 = self->display_height;
-		self->height = self->display_width;
-	} else if (self->rotation == 6) { // Inverted Portrait Mirrored
-		madctl_value |= ILI9342C_MADCTL_MY;
-		self->width	 = self->display_width;
-		self->height = self->display_height;
-	} else if (self->rotation == 7) { // Inverted Landscape Mirrored
-		madctl_value |= ILI9342C_MADCTL_MX | ILI9342C_MADCTL_MY | ILI9342C_MADCTL_MV;
-		self->width	 = self->display_height;
-		self->height = self->display_width;
+	if (!out_clip(dev, rect, &r)) {
+		return 1;
+	}
+	if (dev->strip_rows && r.top != dev->strip_top) {
+		strip_flush(dev);
 	}
+	dev->strip_top = r.top;
+	dev->strip_rows = r.bottom - r.top + 1;
 
-	const uint8_t madctl[] = {madctl_value};
-	write_cmd(self, ILI9342C_MADCTL, madctl, 1);
+    // Copy the visible part of the decompressed RGB rectanglar to the strip (assuming RGB565)
+	out_copy(bitmap, rect, &r, dev->fbuf + 2 * (r.left - dev->clip.left), dev->wfbuf);
+
+    return 1;    // Continue to decompress
 }
 
+//
+// Decoder buffers, kept from image to image by a JpegDecoder or allocated for
+// a single jpg() call
+//
 
-static mp_obj_t ili9342c_ILI9342C_rotation(mp_obj_t self_in, mp_obj_t value) {
-	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(self_in);
+struct _ili9342c_JpegDecoder_obj_t {
+	mp_obj_base_t base;
+	ili9342c_ILI9342C_obj_t *display;	// display decode() draws on
+	mp_int_t method;					// method used when decode() is not given one
+	uint8_t *pool;						// work area for tables, MCU and input buffers
+	size_t pool_size;					// size of pool
+	size_t read_buffer;					// size of the input buffer in the pool
+	uint8_t *ahead;						// read ahead buffer, or NULL
+	size_t ahead_size;					// size of ahead
+	uint8_t *buffer;					// output buffer, NULL until first needed
+	size_t buffer_size;					// size of buffer
+	bool fixed;							// buffer can not be grown
+};
 
-	mp_int_t rotation = mp_obj_get_int(value) % 8;
-	self->rotation	  = rotation;
-	set_rotation(self);
-	return mp_const_none;
+static void jpg_init(ili9342c_JpegDecoder_obj_t *dec, mp_int_t read_buffer, mp_int_t read_ahead, mp_int_t pool_size) {
+	if (read_buffer < JD_SZBUF) {
+		mp_raise_ValueError(MP_ERROR_TEXT("read_buffer must be at least 512"));
+	}
+	if (read_ahead < 0) {
+		mp_raise_ValueError(MP_ERROR_TEXT("read_ahead must be positive"));
+	}
+	dec->read_buffer = read_buffer;
+	dec->pool_size	 = (pool_size) ? pool_size : JPG_WORK_SIZE + read_buffer;
+	dec->pool		 = m_new(uint8_t, dec->pool_size);
+	dec->ahead_size	 = read_ahead;
+	dec->ahead		 = (read_ahead) ? m_new(uint8_t, read_ahead) : NULL;
 }
 
-MP_DEFINE_CONST_FUN_OBJ_2(ili9342c_ILI9342C_rotation_obj, ili9342c_ILI9342C_rotation);
-
+// free the buffers of a decoder used for a single image
+static void jpg_free(ili9342c_JpegDecoder_obj_t *dec) {
+	if (!dec->fixed) {
+		m_del(uint8_t, dec->buffer, dec->buffer_size);
+	}
+	m_del(uint8_t, dec->ahead, dec->ahead_size);
+	m_del(uint8_t, dec->pool, dec->pool_size);
+}
 
-static mp_obj_t ili9342c_ILI9342C_width(mp_obj_t self_in) {
-	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(self_in);
-	return mp_obj_new_int(self->width);
+static void jpg_close(mp_obj_t source, IODEV *devid) {
+	if (mp_obj_is_str(source)) {
+		mp_close(devid->fp);
+	}
 }
 
-MP_DEFINE_CONST_FUN_OBJ_1(ili9342c_ILI9342C_width_obj, ili9342c_ILI9342C_width);
+// open source and read the jpg's header into jdec
+static void jpg_open(ili9342c_JpegDecoder_obj_t *dec, mp_obj_t source, JDEC *jdec, IODEV *devid) {
+	mp_buffer_info_t bufinfo;
 
-static mp_obj_t ili9342c_ILI9342C_height(mp_obj_t self_in) {
-	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(self_in);
-	return mp_obj_new_int(self->height);
+	// a blit_buffer_async() transfer still has CS low on the bus a file may be read over
+	if (dec->display) {
+		async_wait(dec->display);
+	}
+	memset(devid, 0, sizeof(*devid));
+	if (mp_obj_is_str(source)) {
+		devid->fp = mp_open(mp_obj_str_get_str(source), "rb");
+	} else if (mp_get_buffer(source, &bufinfo, MP_BUFFER_READ)) {
+		devid->data = bufinfo.buf;
+		devid->data_len = bufinfo.len;
+	} else {
+		devid->fp = mp_file_from_file_obj(source);
+	}
+	if (devid->fp) {
+		devid->ahead = dec->ahead;
+		devid->ahead_size = dec->ahead_size;
+	}
+
+	if (jd_prepare(jdec, in_func, dec->pool, dec->pool_size, dec->read_buffer, devid) != JDR_OK) {
+		jpg_close(source, devid);
+		mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("jpg prepare failed."));
+	}
+	if (devid->data) {
+		jdec->inref = in_ref;
+	}
 }
 
-MP_DEFINE_CONST_FUN_OBJ_1(ili9342c_ILI9342C_height_obj, ili9342c_ILI9342C_height);
+// the jd_decomp scale for a scale of 1, 2, 4 or 8
+static uint8_t jpg_scale(mp_int_t scale) {
+	switch (scale) {
+		case 1:
+			return 0;
+		case 2:
+			return 1;
+		case 4:
+			return 2;
+		case 8:
+			return 3;
+	}
+	mp_raise_ValueError(MP_ERROR_TEXT("scale must be 1, 2, 4 or 8"));
+}
 
-static mp_obj_t ili9342c_ILI9342C_vscrdef(size_t n_args, const mp_obj_t *args) {
-	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+// the crop (x, y, width, height) in crop_in, or all of the image when crop_in
+// is NULL or None
+static void jpg_crop(mp_obj_t crop_in, mp_int_t crop[4]) {
+	crop[0] = crop[1] = 0;
+	crop[2] = crop[3] = INT16_MAX;
+
+	if (crop_in != MP_OBJ_NULL && crop_in != mp_const_none) {
+		mp_obj_t *items;
+		mp_obj_get_array_fixed_n(crop_in, 4, &items);
+		for (int i = 0; i < 4; i++) {
+			crop[i] = mp_obj_get_int(items[i]);
+		}
+	}
+}
 
-	mp_int_t tfa = mp_obj_get_int(args[1]);
-	mp_int_t vsa = mp_obj_get_int(args[2]);
-	mp_int_t bfa = mp_obj_get_int(args[3]);
+// decode the crop of the jpg opened by jpg_open, scaled down by 1 << scale
+// with its upper left corner at x, y on the display, then close source. MCUs
+// outside the crop or the display are not decoded.
+static void jpg_render(ili9342c_JpegDecoder_obj_t *dec, ili9342c_ILI9342C_obj_t *self, mp_obj_t source, JDEC *jdec, IODEV *devid, mp_int_t x, mp_int_t y, mp_int_t mode, uint8_t scale, const mp_int_t crop[4]) {
+	int (*outfunc)(JDEC*,void*,JRECT*);
 
-	uint8_t buf[6] = {(tfa) >> 8, (tfa) &0xFF, (vsa) >> 8, (vsa) &0xFF, (bfa) >> 8, (bfa) &0xFF};
-	write_cmd(self, ILI9342C_VSCRDEF, buf, 6);
+    JRESULT res;                        // Result code of TJpgDec API
+    size_t bufsize;
 
-	return mp_const_none;
-}
+	// the crop in pixels of the scaled image
+	mp_int_t left	= MAX(crop[0], 0) >> scale;
+	mp_int_t top	= MAX(crop[1], 0) >> scale;
+	mp_int_t right	= (MIN(crop[0] + crop[2], jdec->width) - 1) >> scale;
+	mp_int_t bottom = (MIN(crop[1] + crop[3], jdec->height) - 1) >> scale;
+
+	right  = MIN(right, (jdec->width >> scale) - 1);
+	bottom = MIN(bottom, (jdec->height >> scale) - 1);
+
+	// the part of the crop on the display
+	devid->x = x - left;
+	devid->y = y - top;
+	left   = MAX(left, -devid->x);
+	top	   = MAX(top, -devid->y);
+	right  = MIN(right, (mp_int_t) self->width - 1 - devid->x);
+	bottom = MIN(bottom, (mp_int_t) self->height - 1 - devid->y);
+
+	if (left > right || top > bottom) {
+		jpg_close(source, devid);
+		return;
+	}
+	devid->clip.left   = left;
+	devid->clip.top	   = top;
+	devid->clip.right  = right;
+	devid->clip.bottom = bottom;
+	jdec->crop.left	   = left << scale;
+	jdec->crop.top	   = top << scale;
+	jdec->crop.right   = ((right + 1) << scale) - 1;
+	jdec->crop.bottom  = ((bottom + 1) << scale) - 1;
+	devid->wfbuf	   = right - left + 1;
+
+	// Initialize output device
+	if (mode == JPG_MODE_FAST) {
+		bufsize = 2 * devid->wfbuf * (bottom - top + 1);
+		outfunc = out_fast;
+	} else if (mode == JPG_MODE_STRIP) {
+		bufsize = 2 * devid->wfbuf * ((jdec->msy*8) >> scale);
+		outfunc = out_strip;
+	} else {
+		bufsize = 2 * jdec->msx*8 * jdec->msy*8;
+		outfunc = out_slow;
+	}
+	if (bufsize > dec->buffer_size) {
+		if (dec->fixed) {
+			jpg_close(source, devid);
+			mp_raise_msg(&mp_type_OSError, MP_ERROR_TEXT("buffer too small"));
+		}
+		m_del(uint8_t, dec->buffer, dec->buffer_size);
+		dec->buffer = NULL;
+		dec->buffer_size = 0;
+		dec->buffer = m_new(uint8_t, bufsize);
+		dec->buffer_size = bufsize;
+	}
 
-MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_vscrdef_obj, 4, 4, ili9342c_ILI9342C_vscrdef);
+	devid->fbuf = dec->buffer;
+	devid->self = self;
+	devid->strip_rows = 0;
+	res = jd_decomp(jdec, outfunc, scale);     // Start to decompress
+	jpg_close(source, devid);
+	if (res != JDR_OK) {
+		mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("jpg decompress failed."));
+	}
 
-static mp_obj_t ili9342c_ILI9342C_vscsad(mp_obj_t self_in, mp_obj_t vssa_in) {
-	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(self_in);
+	if (mode == JPG_MODE_FAST) {
+		set_window(self, left + devid->x, top + devid->y, right + devid->x, bottom + devid->y);
+		write_data(self, dec->buffer, bufsize);
+		queue_flush(self);
+	} else if (mode == JPG_MODE_STRIP) {
+		strip_flush(devid);
+	}
+}
 
-	mp_int_t vssa	= mp_obj_get_int(vssa_in);
-	uint8_t	 buf[2] = {(vssa) >> 8, (vssa) &0xFF};
-	write_cmd(self, ILI9342C_VSCSAD, buf, 2);
+// decode the crop (x, y, width, height) of source, or all of it when crop_in
+// is NULL or None, scaled down by scale with its upper left corner at x, y on
+// the display.
+static void jpg_draw(ili9342c_JpegDecoder_obj_t *dec, ili9342c_ILI9342C_obj_t *self, mp_obj_t source, mp_int_t x, mp_int_t y, mp_int_t mode, mp_int_t scale_in, mp_obj_t crop_in) {
+    JDEC jdec;                          // Decompression object
+    IODEV devid;                        // User defined device identifier
+	uint8_t scale = jpg_scale(scale_in);
+	mp_int_t crop[4];
 
-	return mp_const_none;
+	jpg_crop(crop_in, crop);
+	jpg_open(dec, source, &jdec, &devid);
+	jpg_render(dec, self, source, &jdec, &devid, x, y, mode, scale, crop);
 }
 
-MP_DEFINE_CONST_FUN_OBJ_2(ili9342c_ILI9342C_vscsad_obj, ili9342c_ILI9342C_vscsad);
+static mp_obj_t ili9342c_ILI9342C_jpg(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+	enum { ARG_self, ARG_jpg, ARG_x, ARG_y, ARG_method, ARG_scale, ARG_crop, ARG_read_buffer, ARG_read_ahead, ARG_pool_size };
+	static const mp_arg_t allowed_args[] = {
+		{MP_QSTR_self, MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL}},
+		{MP_QSTR_jpg, MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL}},
+		{MP_QSTR_x, MP_ARG_REQUIRED | MP_ARG_INT, {.u_int = 0}},
+		{MP_QSTR_y, MP_ARG_REQUIRED | MP_ARG_INT, {.u_int = 0}},
+		{MP_QSTR_method, MP_ARG_INT, {.u_int = JPG_MODE_FAST}},
+		{MP_QSTR_scale, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 1}},
+		{MP_QSTR_crop, MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL}},
+		{MP_QSTR_read_buffer, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = JD_SZBUF}},
+		{MP_QSTR_read_ahead, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 0}},
+		{MP_QSTR_pool_size, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 0}},
+	};
+	mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+	mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
 
-static mp_obj_t ili9342c_ILI9342C_init(mp_obj_t self_in) {
-	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(self_in);
-	ili9342c_ILI9342C_hard_reset(self_in);
-	ili9342c_ILI9342C_soft_reset(self_in);
-	write_cmd(self, ILI9342C_SLPOUT, NULL, 0);
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[ARG_self].u_obj);
+	ili9342c_JpegDecoder_obj_t dec;
 
-	const uint8_t color_mode[] = {COLOR_MODE_65K | COLOR_MODE_16BIT};
-	write_cmd(self, ILI9342C_COLMOD, color_mode, 1);
-	mp_hal_delay_ms(10);
+	// use the display's buffer if it has one, else one just for this image
+	memset(&dec, 0, sizeof(dec));
+	dec.display = self;
+	jpg_init(&dec, args[ARG_read_buffer].u_int, args[ARG_read_ahead].u_int, args[ARG_pool_size].u_int);
+	if (self->buffer_size) {
+		dec.buffer		= (uint8_t *) self->i2c_buffer;
+		dec.buffer_size = self->buffer_size;
+		dec.fixed		= true;
+	}
 
-	set_rotation(self);
+	// free the buffers even if the jpg fails to decode
+	nlr_buf_t nlr;
 
-	write_cmd(self, ILI9342C_INVON, NULL, 0);
-	mp_hal_delay_ms(10);
-	write_cmd(self, ILI9342C_NORON, NULL, 0);
-	mp_hal_delay_ms(10);
+	if (nlr_push(&nlr) == 0) {
+		jpg_draw(&dec, self, args[ARG_jpg].u_obj, args[ARG_x].u_int, args[ARG_y].u_int, args[ARG_method].u_int, args[ARG_scale].u_int, args[ARG_crop].u_obj);
+		nlr_pop();
+		jpg_free(&dec);
+		return mp_const_none;
+	}
+	jpg_free(&dec);
+	nlr_jump(nlr.ret_val);
+}
 
-	const mp_obj_t args[] = {
-		self_in,
-		mp_obj_new_int(0),
-		mp_obj_new_int(0),
-		mp_obj_new_int(self->width),
-		mp_obj_new_int(self->height),
-		mp_obj_new_int(BLACK)};
-	ili9342c_ILI9342C_fill_rect(6, args);
+static MP_DEFINE_CONST_FUN_OBJ_KW(ili9342c_ILI9342C_jpg_obj, 4, ili9342c_ILI9342C_jpg);
 
-	if (self->backlight)
-		mp_hal_pin_write(self->backlight, 1);
+#if defined(ILI9342C_MOCK_SPI) && JD_REFKERNEL
 
-	write_cmd(self, ILI9342C_DISPON, NULL, 0);
-	mp_hal_delay_ms(500);
+//
+//	jpg_pixels(jpg[, scale, reference]) returns a bytearray of the RGB565
+//	pixels of all of jpg decoded at scale, with the decoder's IDCT and colour
+//	conversion or, if reference is True, the reference ones they replaced, for
+//	examples/UNIX/jpg_kernels.py
+//
 
-	return mp_const_none;
+static mp_obj_t ili9342c_jpg_pixels(size_t n_args, const mp_obj_t *args) {
+	ili9342c_JpegDecoder_obj_t dec;
+	JDEC jdec;
+	IODEV devid;
+	uint8_t scale = jpg_scale((n_args > 1) ? mp_obj_get_int(args[1]) : 1);
+
+	memset(&dec, 0, sizeof(dec));
+	jpg_init(&dec, JD_SZBUF, 0, 0);
+	jpg_open(&dec, args[0], &jdec, &devid);
+	jdec.refkernel = (n_args > 2) && mp_obj_is_true(args[2]);
+
+	devid.clip.right  = (jdec.width >> scale) - 1;
+	devid.clip.bottom = (jdec.height >> scale) - 1;
+	devid.wfbuf		  = devid.clip.right + 1;
+	size_t len		  = 2 * devid.wfbuf * (devid.clip.bottom + 1);
+	devid.fbuf		  = m_new(uint8_t, len);
+
+	JRESULT res = jd_decomp(&jdec, out_fast, scale);
+	jpg_close(args[0], &devid);
+	m_del(uint8_t, dec.pool, dec.pool_size);
+	if (res != JDR_OK) {
+		m_del(uint8_t, devid.fbuf, len);
+		mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("jpg decompress failed."));
+	}
+	return mp_obj_new_bytearray_by_ref(len, devid.fbuf);
 }
-MP_DEFINE_CONST_FUN_OBJ_1(ili9342c_ILI9342C_init_obj, ili9342c_ILI9342C_init);
-
-static mp_obj_t ili9342c_ILI9342C_hline(size_t n_args, const mp_obj_t *args) {
-	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_jpg_pixels_obj, 1, 3, ili9342c_jpg_pixels);
 
-	mp_int_t x	   = mp_obj_get_int(args[1]);
-	mp_int_t y	   = mp_obj_get_int(args[2]);
-	mp_int_t w	   = mp_obj_get_int(args[3]);
-	mp_int_t color = mp_obj_get_int(args[4]);
+#endif
 
-	fast_hline(self, x, y, w, color);
+//
+// Thread safety
+//
+// Every method holds the display's lock while it runs, so a thread can not
+// draw into the window, buffers or command queue of a call still in progress
+// on another, for instance while the first waits for a transfer with the GIL
+// released. A with block holds the lock across a sequence of calls. Waiting
+// for the lock releases the GIL.
+//
+// A method that raises part way through a drawing is cleaned up on the way
+// out, thread safe or not: what it queued is dropped and its CS and the bus
+// are released, so the display and the others on its bus can still be used.
+//
 
-	return mp_const_none;
+// the display a method draws on, the object itself or a JpegDecoder's display
+static ili9342c_ILI9342C_obj_t *display_of(mp_obj_t self_in) {
+	if (mp_obj_is_type(self_in, &ili9342c_ILI9342C_type)) {
+		return MP_OBJ_TO_PTR(self_in);
+	}
+	if (mp_obj_is_type(self_in, &ili9342c_JpegDecoder_type)) {
+		return ((ili9342c_JpegDecoder_obj_t *) MP_OBJ_TO_PTR(self_in))->display;
+	}
+	return NULL;
 }
-static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_hline_obj, 5, 5, ili9342c_ILI9342C_hline);
-
-static mp_obj_t ili9342c_ILI9342C_vline(size_t n_args, const mp_obj_t *args) {
-	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
 
-	mp_int_t x	   = mp_obj_get_int(args[1]);
-	mp_int_t y	   = mp_obj_get_int(args[2]);
-	mp_int_t w	   = mp_obj_get_int(args[3]);
-	mp_int_t color = mp_obj_get_int(args[4]);
+// give up what a method that raised left behind on the bus
+static void display_abort(ili9342c_ILI9342C_obj_t *self) {
+	self->queue_len = 0;
+	window_invalidate(self);
+	if (self->cs_active) {
+		CS_HIGH();
+		self->cs_active = false;
+		bus_release(self);
+	}
+}
 
-	fast_vline(self, x, y, w, color);
+// call a method with the display of args[0] locked, cleaning up if it raises
+static mp_obj_t display_call(mp_obj_t fun, size_t n_args, size_t n_kw, const mp_obj_t *args) {
+	ili9342c_ILI9342C_obj_t *self = display_of(args[0]);
+	if (self == NULL) {
+		return mp_call_function_n_kw(fun, n_args, n_kw, args);
+	}
+	nlr_buf_t nlr;
+
+	display_lock(self);
+	if (nlr_push(&nlr) == 0) {
+		mp_obj_t result = mp_call_function_n_kw(fun, n_args, n_kw, args);
+		nlr_pop();
+		display_unlock(self);
+		return result;
+	}
+	display_abort(self);
+	display_unlock(self);
+	nlr_jump(nlr.ret_val);
+}
 
-	return mp_const_none;
+// as display_call, passing the keyword arguments on after the positional ones
+static mp_obj_t display_call_kw(mp_obj_t fun, size_t n_args, const mp_obj_t *args, mp_map_t *kw_args) {
+	mp_obj_t all_args[n_args + 2 * kw_args->used];
+	size_t n_kw = 0;
+
+	memcpy(all_args, args, n_args * sizeof(mp_obj_t));
+	for (size_t i = 0; i < kw_args->alloc; i++) {
+		if (mp_map_slot_is_filled(kw_args, i)) {
+			all_args[n_args + 2 * n_kw] = kw_args->table[i].key;
+			all_args[n_args + 2 * n_kw + 1] = kw_args->table[i].value;
+			n_kw++;
+		}
+	}
+	return display_call(fun, n_args, n_kw, all_args);
 }
-static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_vline_obj, 5, 5, ili9342c_ILI9342C_vline);
 
-static mp_obj_t ili9342c_ILI9342C_rect(size_t n_args, const mp_obj_t *args) {
-	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+#define LOCKED_METHOD(name)                                                        \
+	static mp_obj_t name##_locked(size_t n_args, const mp_obj_t *args) {           \
+		return display_call(MP_OBJ_FROM_PTR(&name##_obj), n_args, 0, args);        \
+	}                                                                              \
+	static MP_DEFINE_CONST_FUN_OBJ_VAR(name##_locked_obj, 1, name##_locked);
+
+#define LOCKED_METHOD_KW(name)                                                     \
+	static mp_obj_t name##_locked(size_t n_args, const mp_obj_t *args, mp_map_t *kw_args) { \
+		return display_call_kw(MP_OBJ_FROM_PTR(&name##_obj), n_args, args, kw_args); \
+	}                                                                              \
+	static MP_DEFINE_CONST_FUN_OBJ_KW(name##_locked_obj, 1, name##_locked);
+
+#define DISPLAY_METHOD(name) MP_ROM_PTR(&name##_locked_obj)
+
+LOCKED_METHOD(ili9342c_ILI9342C_write)
+LOCKED_METHOD(ili9342c_ILI9342C_write_len)
+LOCKED_METHOD(ili9342c_ILI9342C_glyph_cache)
+LOCKED_METHOD(ili9342c_ILI9342C_glyph_cache_stats)
+LOCKED_METHOD(ili9342c_ILI9342C_glyph_cache_purge)
+LOCKED_METHOD(ili9342c_ILI9342C_hard_reset)
+LOCKED_METHOD(ili9342c_ILI9342C_soft_reset)
+LOCKED_METHOD(ili9342c_ILI9342C_sleep_mode)
+LOCKED_METHOD(ili9342c_ILI9342C_inversion_mode)
+LOCKED_METHOD(ili9342c_ILI9342C_set_window)
+LOCKED_METHOD(ili9342c_ILI9342C_init)
+LOCKED_METHOD(ili9342c_ILI9342C_pixel)
+LOCKED_METHOD(ili9342c_ILI9342C_line)
+LOCKED_METHOD(ili9342c_ILI9342C_polyline)
+LOCKED_METHOD(ili9342c_ILI9342C_circle)
+LOCKED_METHOD(ili9342c_ILI9342C_fill_circle)
+LOCKED_METHOD(ili9342c_ILI9342C_ellipse)
+LOCKED_METHOD(ili9342c_ILI9342C_fill_ellipse)
+LOCKED_METHOD(ili9342c_ILI9342C_triangle)
+LOCKED_METHOD(ili9342c_ILI9342C_fill_triangle)
+LOCKED_METHOD(ili9342c_ILI9342C_polygon)
+LOCKED_METHOD(ili9342c_ILI9342C_fill_polygon)
+LOCKED_METHOD(ili9342c_ILI9342C_round_rect)
+LOCKED_METHOD(ili9342c_ILI9342C_fill_round_rect)
+LOCKED_METHOD(ili9342c_ILI9342C_blit_buffer)
+LOCKED_METHOD(ili9342c_ILI9342C_blit_buffer_async)
+LOCKED_METHOD(ili9342c_ILI9342C_wait)
+LOCKED_METHOD(ili9342c_ILI9342C_draw)
+LOCKED_METHOD(ili9342c_ILI9342C_bitmap)
+LOCKED_METHOD(ili9342c_ILI9342C_sprites)
+LOCKED_METHOD(ili9342c_ILI9342C_fill_rect)
+LOCKED_METHOD(ili9342c_ILI9342C_fill)
+LOCKED_METHOD(ili9342c_ILI9342C_hline)
+LOCKED_METHOD(ili9342c_ILI9342C_vline)
+LOCKED_METHOD(ili9342c_ILI9342C_rect)
+LOCKED_METHOD(ili9342c_ILI9342C_text)
+LOCKED_METHOD(ili9342c_ILI9342C_rotation)
+LOCKED_METHOD(ili9342c_ILI9342C_width)
+LOCKED_METHOD(ili9342c_ILI9342C_height)
+LOCKED_METHOD(ili9342c_ILI9342C_vscrdef)
+LOCKED_METHOD(ili9342c_ILI9342C_vscsad)
+LOCKED_METHOD_KW(ili9342c_ILI9342C_jpg)
+LOCKED_METHOD(ili9342c_ILI9342C_show)
 
-	mp_int_t x	   = mp_obj_get_int(args[1]);
-	mp_int_t y	   = mp_obj_get_int(args[2]);
-	mp_int_t w	   = mp_obj_get_int(args[3]);
-	mp_int_t h	   = mp_obj_get_int(args[4]);
-	mp_int_t color = mp_obj_get_int(args[5]);
+//
+//	with display: holds the lock for the calls in the block
+//
 
-	fast_hline(self, x, y, w, color);
-	fast_vline(self, x, y, h, color);
-	fast_hline(self, x, y + h - 1, w, color);
-	fast_vline(self, x + w - 1, y, h, color);
+static mp_obj_t ili9342c_ILI9342C___enter__(mp_obj_t self_in) {
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(self_in);
+	display_lock(self);
+	return self_in;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(ili9342c_ILI9342C___enter___obj, ili9342c_ILI9342C___enter__);
+
+static mp_obj_t ili9342c_ILI9342C___exit__(size_t n_args, const mp_obj_t *args) {
+	(void) n_args;
+	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+	display_unlock(self);
 	return mp_const_none;
 }
-static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_rect_obj, 6, 6, ili9342c_ILI9342C_rect);
+static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C___exit___obj, 1, 4, ili9342c_ILI9342C___exit__);
 
-static uint16_t color565(uint8_t r, uint8_t g, uint8_t b) {
-	return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | ((b & 0xF8) >> 3);
-}
+//
+// Shared bus
+//
+// ili9342c.Bus(spi) is passed to several ILI9342C in place of the SPI bus to
+// share it between them, see Locks.
+//
 
-static mp_obj_t ili9342c_color565(mp_obj_t r, mp_obj_t g, mp_obj_t b) {
-	return MP_OBJ_NEW_SMALL_INT(color565(
-		(uint8_t) mp_obj_get_int(r),
-		(uint8_t) mp_obj_get_int(g),
-		(uint8_t) mp_obj_get_int(b)));
+static void ili9342c_Bus_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind) {
+	(void) kind;
+	ili9342c_Bus_obj_t *self = MP_OBJ_TO_PTR(self_in);
+	mp_printf(print, "<Bus displays=%u, spi=%p>", self->count, self->spi_obj);
 }
-static MP_DEFINE_CONST_FUN_OBJ_3(ili9342c_color565_obj, ili9342c_color565);
 
-static void map_bitarray_to_rgb565(uint8_t const *bitarray, uint8_t *buffer, int length, int width, uint16_t color, uint16_t bg_color) {
-	int row_pos = 0;
-	for (int i = 0; i < length; i++) {
-		uint8_t byte = bitarray[i];
-		for (int bi = 7; bi >= 0; bi--) {
-			uint8_t	 b		   = byte & (1 << bi);
-			uint16_t cur_color = b ? color : bg_color;
-			*buffer			   = (cur_color & 0xff00) >> 8;
-			buffer++;
-			*buffer = cur_color & 0xff;
-			buffer++;
+//
+//	stats() returns a list with a dict of the bus use of each display
+//
 
-			row_pos++;
-			if (row_pos >= width) {
-				row_pos = 0;
-				break;
-			}
-		}
+static mp_obj_t ili9342c_Bus_stats(mp_obj_t self_in) {
+	ili9342c_Bus_obj_t *self = MP_OBJ_TO_PTR(self_in);
+	mp_obj_t list = mp_obj_new_list(0, NULL);
+
+	for (int i = 0; i < self->count; i++) {
+		ili9342c_ILI9342C_obj_t *display = self->devices[i];
+		mp_obj_t dict = mp_obj_new_dict(6);
+		uint32_t bandwidth = (display->bus_busy_us) ? (uint64_t) display->bus_bytes * 1000000 / display->bus_busy_us : 0;
+
+		mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_bytes), mp_obj_new_int_from_uint(display->bus_bytes));
+		mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_transfers), mp_obj_new_int_from_uint(display->bus_transfers));
+		mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_batches), mp_obj_new_int_from_uint(display->bus_batches));
+		mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_wait_us), mp_obj_new_int_from_uint(display->bus_wait_us));
+		mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_busy_us), mp_obj_new_int_from_uint(display->bus_busy_us));
+		mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_bandwidth), mp_obj_new_int_from_uint(bandwidth));
+		mp_obj_list_append(list, dict);
 	}
+	return list;
 }
+static MP_DEFINE_CONST_FUN_OBJ_1(ili9342c_Bus_stats_obj, ili9342c_Bus_stats);
+
+static mp_obj_t ili9342c_Bus_reset(mp_obj_t self_in) {
+	ili9342c_Bus_obj_t *self = MP_OBJ_TO_PTR(self_in);
+
+	for (int i = 0; i < self->count; i++) {
+		ili9342c_ILI9342C_obj_t *display = self->devices[i];
+		display->bus_bytes	   = 0;
+		display->bus_transfers = 0;
+		display->bus_batches   = 0;
+		display->bus_wait_us   = 0;
+		display->bus_busy_us   = 0;
+	}
+	return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(ili9342c_Bus_reset_obj, ili9342c_Bus_reset);
 
-// bitarray buffer width color bg_color
-
-static mp_obj_t ili9342c_map_bitarray_to_rgb565(size_t n_args, const mp_obj_t *args) {
-	mp_buffer_info_t bitarray_info;
-	mp_buffer_info_t buffer_info;
+static mp_obj_t ili9342c_Bus_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *all_args) {
+	enum { ARG_spi };
+	static const mp_arg_t allowed_args[] = {
+		{MP_QSTR_spi, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL}},
+	};
+	mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+	mp_arg_parse_all_kw_array(n_args, n_kw, all_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
 
-	mp_get_buffer_raise(args[1], &bitarray_info, MP_BUFFER_READ);
-	mp_get_buffer_raise(args[2], &buffer_info, MP_BUFFER_WRITE);
-	mp_int_t width	  = mp_obj_get_int(args[3]);
-	mp_int_t color	  = mp_obj_get_int(args[4]);
-	mp_int_t bg_color = mp_obj_get_int(args[5]);
-	map_bitarray_to_rgb565(bitarray_info.buf, buffer_info.buf, bitarray_info.len, width, color, bg_color);
-	return mp_const_none;
+	ili9342c_Bus_obj_t *self = m_new_obj(ili9342c_Bus_obj_t);
+	memset(self, 0, sizeof(*self));
+	self->base.type = type;
+	self->spi_obj	= (mp_obj_base_t *) MP_OBJ_TO_PTR(args[ARG_spi].u_obj);
+#if ILI9342C_THREAD_SAFE
+	mp_thread_mutex_init(&self->lock);
+#endif
+	return MP_OBJ_FROM_PTR(self);
 }
 
-static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_map_bitarray_to_rgb565_obj, 3, 6, ili9342c_map_bitarray_to_rgb565);
+static const mp_rom_map_elem_t ili9342c_Bus_locals_dict_table[] = {
+	{MP_ROM_QSTR(MP_QSTR_stats), MP_ROM_PTR(&ili9342c_Bus_stats_obj)},
+	{MP_ROM_QSTR(MP_QSTR_reset), MP_ROM_PTR(&ili9342c_Bus_reset_obj)},
+};
+static MP_DEFINE_CONST_DICT(ili9342c_Bus_locals_dict, ili9342c_Bus_locals_dict_table);
+
+#ifdef MP_OBJ_TYPE_GET_SLOT
+
+MP_DEFINE_CONST_OBJ_TYPE(
+    ili9342c_Bus_type,
+    MP_QSTR_Bus,
+    MP_TYPE_FLAG_NONE,
+    print, ili9342c_Bus_print,
+    make_new, ili9342c_Bus_make_new,
+    locals_dict, (mp_obj_dict_t *)&ili9342c_Bus_locals_dict);
+
+#else
+
+const mp_obj_type_t ili9342c_Bus_type = {
+	{&mp_type_type},
+	.name		 = MP_QSTR_Bus,
+	.print		 = ili9342c_Bus_print,
+	.make_new	 = ili9342c_Bus_make_new,
+	.locals_dict = (mp_obj_dict_t *) &ili9342c_Bus_locals_dict,
+};
+
+#endif
 
 //
-// jpg routines
+// JPEG decoder
+//
+// ili9342c.JpegDecoder(display) keeps its work area, read ahead and output
+// buffers from image to image, so drawing many images does not fragment the
+// heap. The output buffer grows to the largest image drawn unless its size is
+// given.
 //
 
-#define JPG_MODE_FAST (0)
-#define JPG_MODE_SLOW (1)
-
-// User defined device identifier
-typedef struct {
-    mp_file_t *fp;          		// File pointer for input function
-    uint8_t *fbuf;          		// Pointer to the frame buffer for output function
-    unsigned int wfbuf;     		// Width of the frame buffer [pix]
-	ili9342c_ILI9342C_obj_t *self;	// display object
-} IODEV;
+static void ili9342c_JpegDecoder_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind) {
+	(void) kind;
+	ili9342c_JpegDecoder_obj_t *self = MP_OBJ_TO_PTR(self_in);
+	mp_printf(print, "<JpegDecoder pool=%u, buffer=%u>", self->pool_size, self->buffer_size);
+}
 
 //
-// User defined input function
+//	decode(jpg, x, y [, method, scale=1, crop=None]) draws jpg like
+//	ILI9342C.jpg() using the decoder's buffers
 //
 
-static unsigned int in_func(    // Returns number of bytes read (zero on error)
-    JDEC* jd,                   // Decompression object
-    uint8_t* buff,              // Pointer to the read buffer (null to remove data)
-    unsigned int nbyte )        // Number of bytes to read/remove
-{
-    IODEV *dev = (IODEV*)jd->device;   // Device identifier for the session (5th argument of jd_prepare function)
-	unsigned int nread;
+static mp_obj_t ili9342c_JpegDecoder_decode(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+	enum { ARG_self, ARG_jpg, ARG_x, ARG_y, ARG_method, ARG_scale, ARG_crop };
+	static const mp_arg_t allowed_args[] = {
+		{MP_QSTR_self, MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL}},
+		{MP_QSTR_jpg, MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL}},
+		{MP_QSTR_x, MP_ARG_REQUIRED | MP_ARG_INT, {.u_int = 0}},
+		{MP_QSTR_y, MP_ARG_REQUIRED | MP_ARG_INT, {.u_int = 0}},
+		{MP_QSTR_method, MP_ARG_INT, {.u_int = -1}},
+		{MP_QSTR_scale, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 1}},
+		{MP_QSTR_crop, MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL}},
+	};
+	mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+	mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
 
-    if (buff) { // Read data from input stream
-        nread = (unsigned int)mp_readinto(dev->fp, buff, nbyte);
-		return nread;
-    }
+	ili9342c_JpegDecoder_obj_t *self = MP_OBJ_TO_PTR(args[ARG_self].u_obj);
+	mp_int_t method = (args[ARG_method].u_int < 0) ? self->method : args[ARG_method].u_int;
 
-    // Remove data from input stream if buff was NULL
-    mp_seek(dev->fp, nbyte, SEEK_CUR);
-    return 0;
+	jpg_draw(self, self->display, args[ARG_jpg].u_obj, args[ARG_x].u_int, args[ARG_y].u_int, method, args[ARG_scale].u_int, args[ARG_crop].u_obj);
+	return mp_const_none;
 }
+static MP_DEFINE_CONST_FUN_OBJ_KW(ili9342c_JpegDecoder_decode_obj, 4, ili9342c_JpegDecoder_decode);
+
+LOCKED_METHOD_KW(ili9342c_JpegDecoder_decode)
 
 //
-// User defined output function
+//	info(jpg) returns a (width, height) tuple read from the jpg's header
+//	without decoding the image
 //
 
-static int out_fast (       // 1:Ok, 0:Aborted
-    JDEC* jd,               // Decompression object
-    void* bitmap,           // Bitmap data to be output
-    JRECT* rect )           // Rectangular region of output image
-{
-    IODEV *dev = (IODEV*)jd->device;
-    uint8_t *src, *dst;
-    uint16_t y, bws, bwd;
-
-    // Copy the decompressed RGB rectanglar to the frame buffer (assuming RGB565)
-    src = (uint8_t*)bitmap;
-    dst = dev->fbuf + 2 * (rect->top * dev->wfbuf + rect->left);    // Left-top of destination rectangular
-    bws = 2 * (rect->right - rect->left + 1);                       // Width of source rectangular [byte]
-    bwd = 2 * dev->wfbuf;                                           // Width of frame buffer [byte]
-    for (y = rect->top; y <= rect->bottom; y++) {
-        memcpy(dst, src, bws);                                      // Copy a line
-        src += bws; dst += bwd;                                     // Next line
-    }
+static mp_obj_t ili9342c_JpegDecoder_info(mp_obj_t self_in, mp_obj_t source) {
+	ili9342c_JpegDecoder_obj_t *self = MP_OBJ_TO_PTR(self_in);
+	JDEC jdec;
+	IODEV devid;
 
-    return 1;    // Continue to decompress
+	jpg_open(self, source, &jdec, &devid);
+	jpg_close(source, &devid);
+
+	mp_obj_t result[2] = {
+		mp_obj_new_int(jdec.width),
+		mp_obj_new_int(jdec.height),
+	};
+	return mp_obj_new_tuple(2, result);
 }
+static MP_DEFINE_CONST_FUN_OBJ_2(ili9342c_JpegDecoder_info_obj, ili9342c_JpegDecoder_info);
+
+LOCKED_METHOD(ili9342c_JpegDecoder_info)
 
 //
-// User defined output function
+// Motion JPEG streams, jpgs one after another or an AVI file of them, read
+// a frame at a time into a buffer that grows to the largest frame
 //
 
-static int out_slow (       // 1:Ok, 0:Aborted
-    JDEC* jd,               // Decompression object
-    void* bitmap,           // Bitmap data to be output
-    JRECT* rect )           // Rectangular region of output image
-{
-	IODEV *dev = (IODEV*)jd->device;
-    ili9342c_ILI9342C_obj_t *self = dev->self;
-
-    uint8_t *src, *dst;
-    uint16_t y;
-	uint16_t wx2 = (rect->right-rect->left+1) *2;
-	uint16_t h = rect->bottom-rect->top+1;
-
-    // if the rect is outside of the screen then return
-    if ((rect->bottom + jd->y_offs > self->height)  || (rect->right + jd->x_offs > self->width)) {
-        return 1;
-    }
+#define MJPEG_BUFFER (4096)
 
-    // Copy the decompressed RGB rectanglar to the frame buffer (assuming RGB565)
-    src = (uint8_t*)bitmap;
-    dst = dev->fbuf;    							// Left-top of destination rectangular
-	for (y = rect->top; y <= rect->bottom; y++) {
-        memcpy(dst, src, wx2);                      // Copy a line
-        src += wx2; dst += wx2;                     // Next line
-    }
+typedef struct {
+	mp_file_t *fp;			// stream, or NULL when it is in memory
+	uint8_t *buf;			// frames read from the stream, or all of it
+	size_t size;			// size of buf
+	size_t len;				// bytes in buf
+	size_t start;			// first byte of the current frame in buf
+	bool avi;				// AVI file rather than jpgs one after another
+	uint32_t avi_pad;		// padding after the current AVI chunk
+	uint32_t avi_us;		// microseconds per frame from the AVI header, 0 if none
+} MJPEG;
+
+// make the n bytes from start available in buf, false at the end of the stream
+static bool mjpeg_fill(MJPEG *m, size_t n) {
+	while (m->len - m->start < n) {
+		if (m->fp == NULL) {
+			return false;
+		}
+		if (m->start) {
+			memmove(m->buf, m->buf + m->start, m->len - m->start);
+			m->len -= m->start;
+			m->start = 0;
+		}
+		if (n > m->size) {
+			size_t size = MAX(n, 2 * m->size);
+			m->buf = m_renew(uint8_t, m->buf, m->size, size);
+			m->size = size;
+		}
+		mp_int_t nread = mp_readinto(m->fp, m->buf + m->len, m->size - m->len);
+		if (nread <= 0) {
+			return false;
+		}
+		m->len += nread;
+	}
+	return true;
+}
 
-	// blit buffer to display
+// skip n bytes from start, reading through them when the stream is not in memory
+static bool mjpeg_skip(MJPEG *m, size_t n) {
+	while (m->len - m->start < n) {
+		n -= m->len - m->start;
+		m->start = m->len;
+		if (!mjpeg_fill(m, MIN(n, m->size))) {
+			return false;
+		}
+	}
+	m->start += n;
+	return true;
+}
 
-    set_window(
-        self,
-        rect->left + jd->x_offs,
-        rect->top + jd->y_offs,
-        rect->right + jd->x_offs,
-        rect->bottom + jd->y_offs);
+static void mjpeg_close(mp_obj_t source, MJPEG *m) {
+	if (m->fp) {
+		m_del(uint8_t, m->buf, m->size);
+		if (mp_obj_is_str(source)) {
+			mp_close(m->fp);
+		}
+	}
+}
 
-	DC_HIGH();
-	CS_LOW();
-	write_spi(self->spi_obj, (uint8_t *) dev->fbuf, wx2 * h);
-	CS_HIGH();
+// length of the segments of the jpg at p up to the end of its SOS segment,
+// 0 if it has none
+static size_t mjpeg_header(const uint8_t *p, size_t len) {
+	size_t pos = 2;
 
-    return 1;    // Continue to decompress
+	if (len < 2 || p[0] != 0xFF || p[1] != 0xD8) {
+		return 0;
+	}
+	while (pos + 4 <= len && p[pos] == 0xFF) {
+		uint8_t marker = p[pos + 1];
+		pos += 2 + (p[pos + 2] << 8 | p[pos + 3]);
+		if (marker == 0xDA) {
+			return (pos <= len) ? pos : 0;
+		}
+	}
+	return 0;
 }
 
+// find the next jpg of a stream of them, false at the end of the stream
+static bool mjpeg_raw(MJPEG *m, size_t *len, size_t *hdr) {
+	size_t pos = 0;
+	uint8_t *p;
 
-static mp_obj_t ili9342c_ILI9342C_jpg(size_t n_args, const mp_obj_t *args) {
-	ili9342c_ILI9342C_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+	while (pos == 0) {
+		// the SOI marker, skipping anything between the jpgs
+		for (;;) {
+			if (!mjpeg_fill(m, 2)) {
+				return false;
+			}
+			p = m->buf + m->start;
+			if (p[0] == 0xFF && p[1] == 0xD8) {
+				break;
+			}
+			m->start++;
+		}
 
-	const char *filename = mp_obj_str_get_str(args[1]);
-	mp_int_t x	  		 = mp_obj_get_int(args[2]);
-	mp_int_t y	  		 = mp_obj_get_int(args[3]);
+		// the segments up to the SOS segment, so markers inside them are not
+		// taken for the end of the image
+		for (pos = 2;;) {
+			if (!mjpeg_fill(m, pos + 4)) {
+				return false;
+			}
+			p = m->buf + m->start;
+			if (p[pos] != 0xFF) {
+				m->start += 2;			// not a jpg after all, look for the next one
+				pos = 0;
+				break;
+			}
+			uint8_t marker = p[pos + 1];
+			pos += 2 + (p[pos + 2] << 8 | p[pos + 3]);
+			if (marker == 0xDA) {
+				break;
+			}
+		}
+	}
+	*hdr = pos;
 
-	mp_int_t mode;
+	// the entropy coded data up to its EOI marker, or the SOI of the next jpg
+	// when it has none. 0xFF is followed by 0x00 or a restart marker in it.
+	for (;;) {
+		if (!mjpeg_fill(m, pos + 2)) {
+			return false;
+		}
+		p = m->buf + m->start;
+		uint8_t *ff = memchr(p + pos, 0xFF, m->len - m->start - pos - 1);
+		if (ff == NULL) {
+			pos = m->len - m->start - 1;
+			continue;
+		}
+		pos = ff - p;
+		if (p[pos + 1] == 0xD9) {
+			*len = pos + 2;
+			return true;
+		}
+		if (p[pos + 1] == 0xD8) {
+			*len = pos;
+			return true;
+		}
+		pos += (p[pos + 1] == 0xFF) ? 1 : 2;
+	}
+}
 
-	if (n_args > 4)
-		mode = mp_obj_get_int(args[4]);
-	else
-		mode = JPG_MODE_FAST;
+// find the next frame of an AVI file, false at the end of the file. A frame
+// of length 0 repeats the one before it.
+static bool mjpeg_avi(MJPEG *m, size_t *len, size_t *hdr) {
+	if (!mjpeg_skip(m, m->avi_pad)) {
+		return false;
+	}
+	m->avi_pad = 0;
 
-	int (*outfunc)(JDEC*,void*,JRECT*);
+	for (;;) {
+		if (!mjpeg_fill(m, 8)) {
+			return false;
+		}
+		uint8_t *p = m->buf + m->start;
+		uint32_t size = p[4] | p[5] << 8 | p[6] << 16 | (uint32_t) p[7] << 24;
 
-    JRESULT res;                        // Result code of TJpgDec API
-    JDEC jdec;                          // Decompression object
-    void *work = malloc(3100);          // Pointer to the work area
-    IODEV devid;                        // User defined device identifier
-    size_t bufsize;
+		if (!memcmp(p, "RIFF", 4) || !memcmp(p, "LIST", 4)) {
+			m->start += 12;				// the chunks of a list follow its type
+			continue;
+		}
+		if (!memcmp(p, "avih", 4)) {
+			if (!mjpeg_fill(m, 12)) {
+				return false;
+			}
+			p = m->buf + m->start;
+			m->avi_us = p[8] | p[9] << 8 | p[10] << 16 | (uint32_t) p[11] << 24;
+		} else if (p[2] == 'd' && (p[3] == 'c' || p[3] == 'b')) {
+			if (!mjpeg_fill(m, 8 + size)) {
+				return false;
+			}
+			m->start += 8;
+			m->avi_pad = size & 1;
+			*len = size;
+			*hdr = (size) ? mjpeg_header(m->buf + m->start, size) : 0;
+			return true;
+		}
+		if (!mjpeg_skip(m, 8 + size + (size & 1))) {
+			return false;
+		}
+	}
+}
 
-    self->fp = mp_open(filename, "rb");
-	devid.fp = self->fp;
-    if (devid.fp) {
-		// Prepare to decompress
-		res = jd_prepare(&jdec, in_func, work, 3100, &devid);
-		if (res == JDR_OK) {
-			// Initialize output device
-			if (mode == JPG_MODE_FAST) {
-				bufsize = 2 * jdec.width * jdec.height;
-				outfunc = out_fast;
+// draw up to max_frames frames of m, returning a dict of statistics
+static mp_obj_t mjpeg_play(ili9342c_JpegDecoder_obj_t *dec, MJPEG *m, mp_int_t x, mp_int_t y, mp_int_t mode, mp_obj_t fps_in, mp_int_t max_frames, uint8_t scale, const mp_int_t crop[4], mp_obj_t log) {
+	JDEC jdec;
+	IODEV devid;
+	uint8_t *header = NULL;			// headers of the last frame prepared
+	size_t header_size = 0, header_len = 0;
+	mp_uint_t frames = 0, dropped = 0, prepared = 0, decode_us = 0, max_us = 0;
+	mp_uint_t period = 0;
+	size_t len, hdr;
+
+	m->avi = mjpeg_fill(m, 4) && !memcmp(m->buf + m->start, "RIFF", 4);
+
+	mp_uint_t t0 = mp_hal_ticks_us();
+	while (max_frames <= 0 || (mp_int_t) frames < max_frames) {
+		if (!(m->avi ? mjpeg_avi(m, &len, &hdr) : mjpeg_raw(m, &len, &hdr))) {
+			break;
+		}
+		if (frames == 0) {
+			if (fps_in == MP_OBJ_NULL || fps_in == mp_const_none) {
+				period = m->avi_us;
 			} else {
-				bufsize = 2 * jdec.msx*8 * jdec.msy*8;
-				outfunc = out_slow;
-                jdec.x_offs = x;
-                jdec.y_offs = y;
+				mp_float_t fps = mp_obj_is_float(fps_in) ? mp_obj_float_get(fps_in) : mp_obj_get_int(fps_in);
+				period = (fps > 0) ? (mp_uint_t) (1000000 / fps) : 0;
 			}
-			if (self->buffer_size && bufsize > self->buffer_size)
-				mp_raise_msg(&mp_type_OSError, MP_ERROR_TEXT("buffer too small"));
+		}
 
-			if (self->buffer_size == 0) {
-				self->i2c_buffer = m_malloc(bufsize);
+		// drop the frame if the next one is already due, else wait for its time
+		mp_uint_t due = t0 + frames * period;
+		frames++;
+		if (period) {
+			mp_int_t late = (mp_int_t) (mp_hal_ticks_us() - due);
+			if (late >= (mp_int_t) period) {
+				dropped++;
+				m->start += len;
+				continue;
 			}
+			if (late < 0) {
+				mp_hal_delay_us(-late);
+			}
+		}
 
-			if (!self->i2c_buffer)
-				mp_raise_msg(&mp_type_OSError, MP_ERROR_TEXT("out of memory"));
-
-			devid.fbuf = (uint8_t *) self->i2c_buffer;
-			devid.wfbuf = jdec.width;
-			devid.self = self;
-			res = jd_decomp(&jdec, outfunc, 0);        // Start to decompress with 1/1 scaling
-			if (res == JDR_OK) {
-				if (mode == JPG_MODE_FAST) {
-					set_window(self, x, y, x + jdec.width - 1, y + jdec.height - 1);
-					DC_HIGH();
-					CS_LOW();
-					write_spi(self->spi_obj, (uint8_t *) self->i2c_buffer, bufsize);
-					CS_HIGH();
-				}
+		mp_uint_t start = mp_hal_ticks_us();
+		if (len) {
+			memset(&devid, 0, sizeof(devid));
+			devid.data = m->buf + m->start;
+			devid.data_len = len;
+
+			if (header_len && hdr == header_len && !memcmp(header, devid.data, hdr)) {
+				devid.data_pos = hdr;
+				jd_next(&jdec, &devid);
 			} else {
-				mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("jpg decompress failed."));
-			}
-			if (self->buffer_size == 0) {
-				m_free(self->i2c_buffer);       // Discard frame buffer
-				self->i2c_buffer = MP_OBJ_NULL;
+				header_len = 0;
+				if (hdr == 0 || jd_prepare(&jdec, in_func, dec->pool, dec->pool_size, dec->read_buffer, &devid) != JDR_OK) {
+					mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("jpg prepare failed."));
+				}
+				jdec.inref = in_ref;
+				if (hdr > header_size) {
+					header = m_renew(uint8_t, header, header_size, hdr);
+					header_size = hdr;
+				}
+				memcpy(header, devid.data, hdr);
+				header_len = hdr;
+				prepared++;
 			}
-			devid.fbuf = MP_OBJ_NULL;
-		} else {
- 			mp_raise_msg(&mp_type_RuntimeError, MP_ERROR_TEXT("jpg prepare failed."));
+			jpg_render(dec, dec->display, mp_const_none, &jdec, &devid, x, y, mode, scale, crop);
+		}
+		m->start += len;
+
+		mp_uint_t us = mp_hal_ticks_us() - start;
+		decode_us += us;
+		max_us = MAX(max_us, us);
+		if (log != MP_OBJ_NULL) {
+			mp_obj_t entry[3] = {
+				mp_obj_new_int_from_uint(frames - 1),
+				mp_obj_new_int_from_uint(start - t0),
+				mp_obj_new_int_from_uint(us),
+			};
+			mp_obj_list_append(log, mp_obj_new_tuple(3, entry));
 		}
-	    mp_close(devid.fp);
 	}
-	free(work);                 // Discard work area
-	return mp_const_none;
+	mp_uint_t elapsed = mp_hal_ticks_us() - t0;
+	m_del(uint8_t, header, header_size);
+
+	mp_obj_t dict = mp_obj_new_dict(6);
+	mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_frames), mp_obj_new_int_from_uint(frames));
+	mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_dropped), mp_obj_new_int_from_uint(dropped));
+	mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_prepared), mp_obj_new_int_from_uint(prepared));
+	mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_us), mp_obj_new_int_from_uint(elapsed));
+	mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_decode_us), mp_obj_new_int_from_uint(decode_us));
+	mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_max_us), mp_obj_new_int_from_uint(max_us));
+	return dict;
+}
+
+//
+//	play(stream, x, y [, method, fps=None, frames=0, scale=1, crop=None,
+//	log=None]) draws the frames of a Motion JPEG stream, a file name,
+//	stream or buffer of jpgs one after another or an AVI file of them, like
+//	decode(). Frames with the same headers as the one before reuse its
+//	tables. Frames are paced to fps, the AVI file's rate when None, or drawn
+//	as fast as they decode when 0, and a frame is dropped when the one before
+//	took so long it is due to be replaced. Returns a dict of statistics and
+//	appends a (frame, start_us, decode_us) tuple to the list log for each
+//	frame drawn.
+//
+
+static mp_obj_t ili9342c_JpegDecoder_play(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+	enum { ARG_self, ARG_stream, ARG_x, ARG_y, ARG_method, ARG_fps, ARG_frames, ARG_scale, ARG_crop, ARG_log };
+	static const mp_arg_t allowed_args[] = {
+		{MP_QSTR_self, MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL}},
+		{MP_QSTR_stream, MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL}},
+		{MP_QSTR_x, MP_ARG_REQUIRED | MP_ARG_INT, {.u_int = 0}},
+		{MP_QSTR_y, MP_ARG_REQUIRED | MP_ARG_INT, {.u_int = 0}},
+		{MP_QSTR_method, MP_ARG_INT, {.u_int = -1}},
+		{MP_QSTR_fps, MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL}},
+		{MP_QSTR_frames, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 0}},
+		{MP_QSTR_scale, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 1}},
+		{MP_QSTR_crop, MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL}},
+		{MP_QSTR_log, MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL}},
+	};
+	mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+	mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+	ili9342c_JpegDecoder_obj_t *self = MP_OBJ_TO_PTR(args[ARG_self].u_obj);
+	mp_int_t method = (args[ARG_method].u_int < 0) ? self->method : args[ARG_method].u_int;
+	mp_obj_t source = args[ARG_stream].u_obj;
+	mp_obj_t log = args[ARG_log].u_obj;
+	uint8_t scale = jpg_scale(args[ARG_scale].u_int);
+	mp_int_t crop[4];
+	mp_buffer_info_t bufinfo;
+	MJPEG m;
+
+	if (log == mp_const_none) {
+		log = MP_OBJ_NULL;
+	}
+	if (log != MP_OBJ_NULL && !mp_obj_is_type(log, &mp_type_list)) {
+		mp_raise_TypeError(MP_ERROR_TEXT("log must be a list"));
+	}
+	jpg_crop(args[ARG_crop].u_obj, crop);
+
+	async_wait(self->display);
+	memset(&m, 0, sizeof(m));
+	if (!mp_obj_is_str(source) && mp_get_buffer(source, &bufinfo, MP_BUFFER_READ)) {
+		m.buf = bufinfo.buf;
+		m.size = m.len = bufinfo.len;
+	} else {
+		m.fp = mp_obj_is_str(source) ? mp_open(mp_obj_str_get_str(source), "rb") : mp_file_from_file_obj(source);
+		m.size = MJPEG_BUFFER;
+		m.buf = m_new(uint8_t, m.size);
+	}
+
+	// close the stream even if a frame fails to decode
+	nlr_buf_t nlr;
+	mp_obj_t result;
+
+	if (nlr_push(&nlr) == 0) {
+		result = mjpeg_play(self, &m, args[ARG_x].u_int, args[ARG_y].u_int, method, args[ARG_fps].u_obj, args[ARG_frames].u_int, scale, crop, log);
+		nlr_pop();
+		mjpeg_close(source, &m);
+		return result;
+	}
+	mjpeg_close(source, &m);
+	nlr_jump(nlr.ret_val);
+}
+static MP_DEFINE_CONST_FUN_OBJ_KW(ili9342c_JpegDecoder_play_obj, 4, ili9342c_JpegDecoder_play);
+
+LOCKED_METHOD_KW(ili9342c_JpegDecoder_play)
+
+static mp_obj_t ili9342c_JpegDecoder_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *all_args) {
+	enum { ARG_display, ARG_method, ARG_buffer_size, ARG_read_buffer, ARG_read_ahead, ARG_pool_size };
+	static const mp_arg_t allowed_args[] = {
+		{MP_QSTR_display, MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = MP_OBJ_NULL}},
+		{MP_QSTR_method, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = JPG_MODE_FAST}},
+		{MP_QSTR_buffer_size, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 0}},
+		{MP_QSTR_read_buffer, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = JD_SZBUF}},
+		{MP_QSTR_read_ahead, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 0}},
+		{MP_QSTR_pool_size, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 0}},
+	};
+	mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+	mp_arg_parse_all_kw_array(n_args, n_kw, all_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+	if (!mp_obj_is_type(args[ARG_display].u_obj, &ili9342c_ILI9342C_type)) {
+		mp_raise_TypeError(MP_ERROR_TEXT("display must be an ILI9342C"));
+	}
+
+	ili9342c_JpegDecoder_obj_t *self = m_new_obj(ili9342c_JpegDecoder_obj_t);
+	memset(self, 0, sizeof(*self));
+	self->base.type = type;
+	self->display	= MP_OBJ_TO_PTR(args[ARG_display].u_obj);
+	self->method	= args[ARG_method].u_int;
+	jpg_init(self, args[ARG_read_buffer].u_int, args[ARG_read_ahead].u_int, args[ARG_pool_size].u_int);
+
+	if (args[ARG_buffer_size].u_int > 0) {
+		self->buffer_size = args[ARG_buffer_size].u_int;
+		self->buffer	  = m_new(uint8_t, self->buffer_size);
+		self->fixed		  = true;
+	}
+	return MP_OBJ_FROM_PTR(self);
 }
 
-static MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(ili9342c_ILI9342C_jpg_obj, 4, 5, ili9342c_ILI9342C_jpg);
+static const mp_rom_map_elem_t ili9342c_JpegDecoder_locals_dict_table[] = {
+	{MP_ROM_QSTR(MP_QSTR_decode), DISPLAY_METHOD(ili9342c_JpegDecoder_decode)},
+	{MP_ROM_QSTR(MP_QSTR_info), DISPLAY_METHOD(ili9342c_JpegDecoder_info)},
+	{MP_ROM_QSTR(MP_QSTR_play), DISPLAY_METHOD(ili9342c_JpegDecoder_play)},
+};
+static MP_DEFINE_CONST_DICT(ili9342c_JpegDecoder_locals_dict, ili9342c_JpegDecoder_locals_dict_table);
+
+#ifdef MP_OBJ_TYPE_GET_SLOT
+
+MP_DEFINE_CONST_OBJ_TYPE(
+    ili9342c_JpegDecoder_type,
+    MP_QSTR_JpegDecoder,
+    MP_TYPE_FLAG_NONE,
+    print, ili9342c_JpegDecoder_print,
+    make_new, ili9342c_JpegDecoder_make_new,
+    locals_dict, (mp_obj_dict_t *)&ili9342c_JpegDecoder_locals_dict);
+
+#else
+
+const mp_obj_type_t ili9342c_JpegDecoder_type = {
+	{&mp_type_type},
+	.name		 = MP_QSTR_JpegDecoder,
+	.print		 = ili9342c_JpegDecoder_print,
+	.make_new	 = ili9342c_JpegDecoder_make_new,
+	.locals_dict = (mp_obj_dict_t *) &ili9342c_JpegDecoder_locals_dict,
+};
+
+#endif
 
 //
 // Dictionary Table
 //
 
 static const mp_rom_map_elem_t ili9342c_ILI9342C_locals_dict_table[] = {
-	{MP_ROM_QSTR(MP_QSTR_write), MP_ROM_PTR(&ili9342c_ILI9342C_write_obj)},
-	{MP_ROM_QSTR(MP_QSTR_write_len), MP_ROM_PTR(&ili9342c_ILI9342C_write_len_obj)},
-	{MP_ROM_QSTR(MP_QSTR_hard_reset), MP_ROM_PTR(&ili9342c_ILI9342C_hard_reset_obj)},
-	{MP_ROM_QSTR(MP_QSTR_soft_reset), MP_ROM_PTR(&ili9342c_ILI9342C_soft_reset_obj)},
-	{MP_ROM_QSTR(MP_QSTR_sleep_mode), MP_ROM_PTR(&ili9342c_ILI9342C_sleep_mode_obj)},
-	{MP_ROM_QSTR(MP_QSTR_inversion_mode), MP_ROM_PTR(&ili9342c_ILI9342C_inversion_mode_obj)},
-	{MP_ROM_QSTR(MP_QSTR_set_window), MP_ROM_PTR(&ili9342c_ILI9342C_set_window_obj)},
+	{MP_ROM_QSTR(MP_QSTR___enter__), MP_ROM_PTR(&ili9342c_ILI9342C___enter___obj)},
+	{MP_ROM_QSTR(MP_QSTR___exit__), MP_ROM_PTR(&ili9342c_ILI9342C___exit___obj)},
+	{MP_ROM_QSTR(MP_QSTR_write), DISPLAY_METHOD(ili9342c_ILI9342C_write)},
+	{MP_ROM_QSTR(MP_QSTR_write_len), DISPLAY_METHOD(ili9342c_ILI9342C_write_len)},
+	{MP_ROM_QSTR(MP_QSTR_glyph_cache), DISPLAY_METHOD(ili9342c_ILI9342C_glyph_cache)},
+	{MP_ROM_QSTR(MP_QSTR_glyph_cache_stats), DISPLAY_METHOD(ili9342c_ILI9342C_glyph_cache_stats)},
+	{MP_ROM_QSTR(MP_QSTR_glyph_cache_purge), DISPLAY_METHOD(ili9342c_ILI9342C_glyph_cache_purge)},
+	{MP_ROM_QSTR(MP_QSTR_hard_reset), DISPLAY_METHOD(ili9342c_ILI9342C_hard_reset)},
+	{MP_ROM_QSTR(MP_QSTR_soft_reset), DISPLAY_METHOD(ili9342c_ILI9342C_soft_reset)},
+	{MP_ROM_QSTR(MP_QSTR_sleep_mode), DISPLAY_METHOD(ili9342c_ILI9342C_sleep_mode)},
+	{MP_ROM_QSTR(MP_QSTR_inversion_mode), DISPLAY_METHOD(ili9342c_ILI9342C_inversion_mode)},
+	{MP_ROM_QSTR(MP_QSTR_set_window), DISPLAY_METHOD(ili9342c_ILI9342C_set_window)},
 	{MP_ROM_QSTR(MP_QSTR_map_bitarray_to_rgb565), MP_ROM_PTR(&ili9342c_map_bitarray_to_rgb565_obj)},
-	{MP_ROM_QSTR(MP_QSTR_init), MP_ROM_PTR(&ili9342c_ILI9342C_init_obj)},
-	{MP_ROM_QSTR(MP_QSTR_pixel), MP_ROM_PTR(&ili9342c_ILI9342C_pixel_obj)},
-	{MP_ROM_QSTR(MP_QSTR_line), MP_ROM_PTR(&ili9342c_ILI9342C_line_obj)},
-	{MP_ROM_QSTR(MP_QSTR_blit_buffer), MP_ROM_PTR(&ili9342c_ILI9342C_blit_buffer_obj)},
-	{MP_ROM_QSTR(MP_QSTR_draw), MP_ROM_PTR(&ili9342c_ILI9342C_draw_obj)},
-	{MP_ROM_QSTR(MP_QSTR_bitmap), MP_ROM_PTR(&ili9342c_ILI9342C_bitmap_obj)},
-	{MP_ROM_QSTR(MP_QSTR_fill_rect), MP_ROM_PTR(&ili9342c_ILI9342C_fill_rect_obj)},
-	{MP_ROM_QSTR(MP_QSTR_fill), MP_ROM_PTR(&ili9342c_ILI9342C_fill_obj)},
-	{MP_ROM_QSTR(MP_QSTR_hline), MP_ROM_PTR(&ili9342c_ILI9342C_hline_obj)},
-	{MP_ROM_QSTR(MP_QSTR_vline), MP_ROM_PTR(&ili9342c_ILI9342C_vline_obj)},
-	{MP_ROM_QSTR(MP_QSTR_rect), MP_ROM_PTR(&ili9342c_ILI9342C_rect_obj)},
-	{MP_ROM_QSTR(MP_QSTR_text), MP_ROM_PTR(&ili9342c_ILI9342C_text_obj)},
-	{MP_ROM_QSTR(MP_QSTR_rotation), MP_ROM_PTR(&ili9342c_ILI9342C_rotation_obj)},
-	{MP_ROM_QSTR(MP_QSTR_width), MP_ROM_PTR(&ili9342c_ILI9342C_width_obj)},
-	{MP_ROM_QSTR(MP_QSTR_height), MP_ROM_PTR(&ili9342c_ILI9342C_height_obj)},
-	{MP_ROM_QSTR(MP_QSTR_vscrdef), MP_ROM_PTR(&ili9342c_ILI9342C_vscrdef_obj)},
-	{MP_ROM_QSTR(MP_QSTR_vscsad), MP_ROM_PTR(&ili9342c_ILI9342C_vscsad_obj)},
-	{MP_ROM_QSTR(MP_QSTR_jpg), MP_ROM_PTR(&ili9342c_ILI9342C_jpg_obj)},
+	{MP_ROM_QSTR(MP_QSTR_init), DISPLAY_METHOD(ili9342c_ILI9342C_init)},
+	{MP_ROM_QSTR(MP_QSTR_pixel), DISPLAY_METHOD(ili9342c_ILI9342C_pixel)},
+	{MP_ROM_QSTR(MP_QSTR_line), DISPLAY_METHOD(ili9342c_ILI9342C_line)},
+	{MP_ROM_QSTR(MP_QSTR_polyline), DISPLAY_METHOD(ili9342c_ILI9342C_polyline)},
+	{MP_ROM_QSTR(MP_QSTR_circle), DISPLAY_METHOD(ili9342c_ILI9342C_circle)},
+	{MP_ROM_QSTR(MP_QSTR_fill_circle), DISPLAY_METHOD(ili9342c_ILI9342C_fill_circle)},
+	{MP_ROM_QSTR(MP_QSTR_ellipse), DISPLAY_METHOD(ili9342c_ILI9342C_ellipse)},
+	{MP_ROM_QSTR(MP_QSTR_fill_ellipse), DISPLAY_METHOD(ili9342c_ILI9342C_fill_ellipse)},
+	{MP_ROM_QSTR(MP_QSTR_triangle), DISPLAY_METHOD(ili9342c_ILI9342C_triangle)},
+	{MP_ROM_QSTR(MP_QSTR_fill_triangle), DISPLAY_METHOD(ili9342c_ILI9342C_fill_triangle)},
+	{MP_ROM_QSTR(MP_QSTR_polygon), DISPLAY_METHOD(ili9342c_ILI9342C_polygon)},
+	{MP_ROM_QSTR(MP_QSTR_fill_polygon), DISPLAY_METHOD(ili9342c_ILI9342C_fill_polygon)},
+	{MP_ROM_QSTR(MP_QSTR_round_rect), DISPLAY_METHOD(ili9342c_ILI9342C_round_rect)},
+	{MP_ROM_QSTR(MP_QSTR_fill_round_rect), DISPLAY_METHOD(ili9342c_ILI9342C_fill_round_rect)},
+	{MP_ROM_QSTR(MP_QSTR_blit_buffer), DISPLAY_METHOD(ili9342c_ILI9342C_blit_buffer)},
+	{MP_ROM_QSTR(MP_QSTR_blit_buffer_async), DISPLAY_METHOD(ili9342c_ILI9342C_blit_buffer_async)},
+	{MP_ROM_QSTR(MP_QSTR_wait), DISPLAY_METHOD(ili9342c_ILI9342C_wait)},
+	{MP_ROM_QSTR(MP_QSTR_draw), DISPLAY_METHOD(ili9342c_ILI9342C_draw)},
+	{MP_ROM_QSTR(MP_QSTR_bitmap), DISPLAY_METHOD(ili9342c_ILI9342C_bitmap)},
+	{MP_ROM_QSTR(MP_QSTR_sprites), DISPLAY_METHOD(ili9342c_ILI9342C_sprites)},
+	{MP_ROM_QSTR(MP_QSTR_fill_rect), DISPLAY_METHOD(ili9342c_ILI9342C_fill_rect)},
+	{MP_ROM_QSTR(MP_QSTR_fill), DISPLAY_METHOD(ili9342c_ILI9342C_fill)},
+	{MP_ROM_QSTR(MP_QSTR_hline), DISPLAY_METHOD(ili9342c_ILI9342C_hline)},
+	{MP_ROM_QSTR(MP_QSTR_vline), DISPLAY_METHOD(ili9342c_ILI9342C_vline)},
+	{MP_ROM_QSTR(MP_QSTR_rect), DISPLAY_METHOD(ili9342c_ILI9342C_rect)},
+	{MP_ROM_QSTR(MP_QSTR_text), DISPLAY_METHOD(ili9342c_ILI9342C_text)},
+	{MP_ROM_QSTR(MP_QSTR_rotation), DISPLAY_METHOD(ili9342c_ILI9342C_rotation)},
+	{MP_ROM_QSTR(MP_QSTR_width), DISPLAY_METHOD(ili9342c_ILI9342C_width)},
+	{MP_ROM_QSTR(MP_QSTR_height), DISPLAY_METHOD(ili9342c_ILI9342C_height)},
+	{MP_ROM_QSTR(MP_QSTR_vscrdef), DISPLAY_METHOD(ili9342c_ILI9342C_vscrdef)},
+	{MP_ROM_QSTR(MP_QSTR_vscsad), DISPLAY_METHOD(ili9342c_ILI9342C_vscsad)},
+	{MP_ROM_QSTR(MP_QSTR_jpg), DISPLAY_METHOD(ili9342c_ILI9342C_jpg)},
+	{MP_ROM_QSTR(MP_QSTR_show), DISPLAY_METHOD(ili9342c_ILI9342C_show)},
 };
 
 static MP_DEFINE_CONST_DICT(ili9342c_ILI9342C_locals_dict, ili9342c_ILI9342C_locals_dict_table);
@@ -1365,6 +5295,11 @@ mp_obj_t ili9342c_ILI9342C_make_new(const mp_obj_type_t *type, size_t n_args, si
 		ARG_backlight,
 		ARG_rotation,
 		ARG_buffer_size,
+		ARG_framebuffer,
+		ARG_display_list,
+		ARG_max_transfer,
+		ARG_fill_buffer,
+		ARG_glyph_cache,
 	};
 
 	static const mp_arg_t allowed_args[] = {
@@ -1377,6 +5312,11 @@ mp_obj_t ili9342c_ILI9342C_make_new(const mp_obj_type_t *type, size_t n_args, si
 		{MP_QSTR_backlight, MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL}},
 		{MP_QSTR_rotation, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 0}},
 		{MP_QSTR_buffer_size, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 0}},
+		{MP_QSTR_framebuffer, MP_ARG_KW_ONLY | MP_ARG_BOOL, {.u_bool = false}},
+		{MP_QSTR_display_list, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 0}},
+		{MP_QSTR_max_transfer, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 0}},
+		{MP_QSTR_fill_buffer, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = ILI9342C_FILL_BUFFER}},
+		{MP_QSTR_glyph_cache, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = ILI9342C_GLYPH_CACHE}},
 	};
 
 	mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
@@ -1389,6 +5329,10 @@ mp_obj_t ili9342c_ILI9342C_make_new(const mp_obj_type_t *type, size_t n_args, si
 
 	// set parameters
 	mp_obj_base_t *spi_obj = (mp_obj_base_t *) MP_OBJ_TO_PTR(args[ARG_spi].u_obj);
+	if (mp_obj_is_type(args[ARG_spi].u_obj, &ili9342c_Bus_type)) {
+		self->bus = MP_OBJ_TO_PTR(args[ARG_spi].u_obj);
+		spi_obj	  = self->bus->spi_obj;
+	}
 	self->spi_obj		   = spi_obj;
 	self->display_width	   = args[ARG_width].u_int;
 	self->width			   = args[ARG_width].u_int;
@@ -1396,6 +5340,16 @@ mp_obj_t ili9342c_ILI9342C_make_new(const mp_obj_type_t *type, size_t n_args, si
 	self->height		   = args[ARG_height].u_int;
 	self->rotation		   = args[ARG_rotation].u_int % 8;
 	self->buffer_size	   = args[ARG_buffer_size].u_int;
+	self->max_transfer	   = args[ARG_max_transfer].u_int;
+	self->fill_size		   = args[ARG_fill_buffer].u_int / 2;
+	self->glyph_budget	   = MAX(args[ARG_glyph_cache].u_int, 0);
+#if ILI9342C_THREAD_SAFE
+	mp_thread_mutex_init(&self->lock);
+#endif
+
+	if (self->fill_size == 0) {
+		mp_raise_ValueError(MP_ERROR_TEXT("fill_buffer must be at least 2 bytes"));
+	}
 
 	if (self->buffer_size) {
 		self->i2c_buffer = m_malloc(self->buffer_size);
@@ -1406,6 +5360,36 @@ mp_obj_t ili9342c_ILI9342C_make_new(const mp_obj_type_t *type, size_t n_args, si
 		mp_raise_ValueError(MP_ERROR_TEXT("Unsupported display. Only 320x240 and 240x320 displays are supported"));
 	}
 
+	if (args[ARG_framebuffer].u_bool) {
+		self->frame_buffer = m_malloc(self->display_width * self->display_height * 2);
+		if (!self->frame_buffer) {
+			mp_raise_msg(&mp_type_OSError, MP_ERROR_TEXT("out of memory"));
+		}
+		memset(self->frame_buffer, 0, self->display_width * self->display_height * 2);
+		self->fb_top = 0;
+		self->fb_bottom = UINT16_MAX;		// holds every row
+	}
+
+	if (args[ARG_display_list].u_int) {
+		if (self->frame_buffer) {
+			mp_raise_ValueError(MP_ERROR_TEXT("framebuffer and display_list can not be used together"));
+		}
+		if (args[ARG_display_list].u_int < 256) {
+			mp_raise_ValueError(MP_ERROR_TEXT("display_list must be at least 256 bytes"));
+		}
+		self->dl_size = args[ARG_display_list].u_int & ~3;
+		self->display_list = m_malloc(self->dl_size);
+		self->dl_len = 0;
+
+		// rows as wide as the display is in any rotation, within buffer_size if given
+		uint16_t row_size = MAX(self->display_width, self->display_height) * 2;
+		self->band_rows = ILI9342C_BAND_HEIGHT;
+		if (self->buffer_size) {
+			self->band_rows = MAX(1, MIN(self->band_rows, self->buffer_size / row_size));
+		}
+		self->band = m_malloc(row_size * self->band_rows);
+	}
+
 	if (args[ARG_dc].u_obj == MP_OBJ_NULL) {
 		mp_raise_ValueError(MP_ERROR_TEXT("must specify dc pin"));
 	}
@@ -1420,6 +5404,16 @@ mp_obj_t ili9342c_ILI9342C_make_new(const mp_obj_type_t *type, size_t n_args, si
 		self->cs = mp_hal_get_pin_obj(args[ARG_cs].u_obj);
 	}
 
+	if (self->bus) {
+		if (args[ARG_cs].u_obj == MP_OBJ_NULL) {
+			mp_raise_ValueError(MP_ERROR_TEXT("must specify cs pin on a shared bus"));
+		}
+		if (self->bus->count == ILI9342C_BUS_DEVICES) {
+			mp_raise_ValueError(MP_ERROR_TEXT("too many displays on bus"));
+		}
+		self->bus->devices[self->bus->count++] = self;
+	}
+
 	if (args[ARG_backlight].u_obj != MP_OBJ_NULL) {
 		self->backlight = mp_hal_get_pin_obj(args[ARG_backlight].u_obj);
 	}
@@ -1430,8 +5424,19 @@ mp_obj_t ili9342c_ILI9342C_make_new(const mp_obj_type_t *type, size_t n_args, si
 static const mp_map_elem_t ili9342c_module_globals_table[] = {
 	{MP_ROM_QSTR(MP_QSTR___name__), MP_OBJ_NEW_QSTR(MP_QSTR_ili9342c)},
 	{MP_ROM_QSTR(MP_QSTR_color565), (mp_obj_t) &ili9342c_color565_obj},
+	{MP_ROM_QSTR(MP_QSTR_load_font), (mp_obj_t) &ili9342c_load_font_obj},
 	{MP_ROM_QSTR(MP_QSTR_map_bitarray_to_rgb565), (mp_obj_t) &ili9342c_map_bitarray_to_rgb565_obj},
 	{MP_ROM_QSTR(MP_QSTR_ILI9342C), (mp_obj_t) &ili9342c_ILI9342C_type},
+	{MP_ROM_QSTR(MP_QSTR_Sprite), (mp_obj_t) &ili9342c_Sprite_type},
+	{MP_ROM_QSTR(MP_QSTR_Bus), (mp_obj_t) &ili9342c_Bus_type},
+	{MP_ROM_QSTR(MP_QSTR_JpegDecoder), (mp_obj_t) &ili9342c_JpegDecoder_type},
+#ifdef ILI9342C_MOCK_SPI
+	{MP_ROM_QSTR(MP_QSTR_MockSPI), (mp_obj_t) &ili9342c_MockSPI_type},
+	{MP_ROM_QSTR(MP_QSTR_unpack), (mp_obj_t) &ili9342c_unpack_obj},
+#endif
+#if defined(ILI9342C_MOCK_SPI) && JD_REFKERNEL
+	{MP_ROM_QSTR(MP_QSTR_jpg_pixels), (mp_obj_t) &ili9342c_jpg_pixels_obj},
+#endif
 	{MP_ROM_QSTR(MP_QSTR_BLACK), MP_ROM_INT(BLACK)},
 	{MP_ROM_QSTR(MP_QSTR_BLUE), MP_ROM_INT(BLUE)},
 	{MP_ROM_QSTR(MP_QSTR_RED), MP_ROM_INT(RED)},
@@ -1442,6 +5447,7 @@ static const mp_map_elem_t ili9342c_module_globals_table[] = {
 	{MP_ROM_QSTR(MP_QSTR_WHITE), MP_ROM_INT(WHITE)},
 	{MP_ROM_QSTR(MP_QSTR_FAST), MP_ROM_INT(JPG_MODE_FAST)},
 	{MP_ROM_QSTR(MP_QSTR_SLOW), MP_ROM_INT(JPG_MODE_SLOW)},
+	{MP_ROM_QSTR(MP_QSTR_STRIP), MP_ROM_INT(JPG_MODE_STRIP)},
 };
 
 static MP_DEFINE_CONST_DICT(mp_module_ili9342c_globals, ili9342c_module_globals_table);
@@ -19,5 +19,23 @@ target_compile_definitions(usermod_ili9342c INTERFACE
     EXPOSE_EXTRA_METHODS=1
 )
 
+# Replace the SPI bus with the recording MockSPI for host benchmarks
+if(ILI9342C_MOCK_SPI)
+    target_sources(usermod_ili9342c INTERFACE
+        ${CMAKE_CURRENT_LIST_DIR}/mockspi.c
+    )
+    target_compile_definitions(usermod_ili9342c INTERFACE
+        ILI9342C_MOCK_SPI=1
+        JD_REFKERNEL=1
+    )
+endif()
+
+# Decode jpg huffman codes bit by bit, without the 3 KB of lookup tables
+if(DEFINED ILI9342C_JPG_FASTDECODE AND NOT ILI9342C_JPG_FASTDECODE)
+    target_compile_definitions(usermod_ili9342c INTERFACE
+        JD_FASTDECODE=0
+    )
+endif()
+
 # Link our INTERFACE library to the usermod target.
 target_link_libraries(usermod INTERFACE usermod_ili9342c)
\ No newline at end of file
@@ -4,3 +4,17 @@ SRC_USERMOD += $(addprefix $(ILI9342C_MOD_DIR)/, mpfile.c)
 SRC_USERMOD += $(addprefix $(ILI9342C_MOD_DIR)/, tjpgd565.c)
 
 CFLAGS_USERMOD += -I$(ILI9342C_MOD_DIR) -DMODULE_ILI9342C=1 -DMICROPY_PY_FILE_LIKE=1 -DMODULE_ILI9342C_ENABLED=1
+
+# make USER_C_MODULES=... ILI9342C_MOCK_SPI=1 replaces the SPI bus with the
+# recording MockSPI, used by the unix port benchmarks in examples/UNIX, and
+# keeps the reference jpg kernels to check the tuned ones against
+ifeq ($(ILI9342C_MOCK_SPI),1)
+SRC_USERMOD += $(addprefix $(ILI9342C_MOD_DIR)/, mockspi.c)
+CFLAGS_USERMOD += -DILI9342C_MOCK_SPI=1 -DJD_REFKERNEL=1
+endif
+
+# make USER_C_MODULES=... ILI9342C_JPG_FASTDECODE=0 decodes jpg huffman codes
+# bit by bit, leaving the 3 KB of lookup tables out of the decoder's work area
+ifeq ($(ILI9342C_JPG_FASTDECODE),0)
+CFLAGS_USERMOD += -DJD_FASTDECODE=0
+endif
@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2021 Russ Hughes
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <string.h>
+#include "py/obj.h"
+#include "py/runtime.h"
+#include "py/mphal.h"
+
+#if MICROPY_VERSION_MAJOR >= 1 && MICROPY_VERSION_MINOR > 21
+#include "extmod/modmachine.h"
+#else
+#include "extmod/machine_spi.h"
+#endif
+
+#include "ili9342c.h"
+#include "mockspi.h"
+
+static void mockspi_clear(mockspi_obj_t *self) {
+	memset(&self->bytes, 0, offsetof(mockspi_obj_t, baudrate) - offsetof(mockspi_obj_t, bytes));
+}
+
+// wait for the last transfer then keep the bus busy for len bytes
+static void mockspi_busy(mockspi_obj_t *self, size_t len) {
+	if (self->baudrate) {
+		mockspi_wait(&self->base);
+		self->busy_until = mp_hal_ticks_us() + (mp_uint_t) ((uint64_t) len * 8 * 1000000 / self->baudrate);
+	}
+}
+
+static void mockspi_count(mockspi_obj_t *self, size_t len, const uint8_t *src) {
+	self->transfers++;
+	self->bytes += len;
+
+	if (self->dc) {
+		self->data_bytes += len;
+	} else {
+		self->cmd_bytes += len;
+		for (size_t i = 0; i < len; i++) {
+			self->cmds++;
+			switch (src[i]) {
+				case ILI9342C_CASET:
+					self->caset++;
+					break;
+				case ILI9342C_PASET:
+					self->paset++;
+					break;
+				case ILI9342C_RAMWR:
+					self->ramwr++;
+					break;
+			}
+		}
+	}
+}
+
+static void mockspi_transfer(mp_obj_base_t *self_in, size_t len, const uint8_t *src, uint8_t *dest) {
+	mockspi_obj_t *self = (mockspi_obj_t *) self_in;
+
+	mockspi_count(self, len, src);
+	mockspi_busy(self, len);
+	mockspi_wait(self_in);
+
+	if (dest) {
+		memset(dest, 0xff, len);
+	}
+}
+
+void mockspi_cs_write(mp_obj_base_t *spi_obj, mp_obj_t pin, int value) {
+	if (spi_obj->type != &ili9342c_MockSPI_type) {
+		return;
+	}
+	mockspi_obj_t *self = (mockspi_obj_t *) spi_obj;
+
+	int i = 0;
+	while (i < MOCKSPI_DEVICES - 1 && self->cs_pins[i] && self->cs_pins[i] != pin) {
+		i++;
+	}
+	self->cs_pins[i] = pin;
+
+	uint8_t bit = 1 << i;
+	if (((self->cs_low & bit) == 0) != (value != 0)) {
+		if (value) {
+			self->cs_low &= ~bit;
+		} else {
+			if (self->cs_low) {
+				self->cs_overlaps++;
+			}
+			self->cs_low |= bit;
+		}
+		self->cs_toggles++;
+	}
+	self->cs = (self->cs_low == 0);
+}
+
+void mockspi_dc_write(mp_obj_base_t *spi_obj, int value) {
+	if (spi_obj->type != &ili9342c_MockSPI_type) {
+		return;
+	}
+	mockspi_obj_t *self = (mockspi_obj_t *) spi_obj;
+	if (self->dc != (value != 0)) {
+		self->dc = (value != 0);
+		self->dc_toggles++;
+	}
+}
+
+// start a transfer and return without waiting for it, as a DMA would
+void mockspi_start(mp_obj_base_t *spi_obj, const uint8_t *buf, size_t len) {
+	if (spi_obj->type != &ili9342c_MockSPI_type) {
+		return;
+	}
+	mockspi_obj_t *self = (mockspi_obj_t *) spi_obj;
+	mockspi_count(self, len, buf);
+	mockspi_busy(self, len);
+}
+
+void mockspi_wait(mp_obj_base_t *spi_obj) {
+	if (spi_obj->type != &ili9342c_MockSPI_type) {
+		return;
+	}
+	mockspi_obj_t *self = (mockspi_obj_t *) spi_obj;
+	while ((mp_int_t) (self->busy_until - mp_hal_ticks_us()) > 0) {
+	}
+}
+
+static void mockspi_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind) {
+	(void) kind;
+	mockspi_obj_t *self = MP_OBJ_TO_PTR(self_in);
+	mp_printf(print, "<MockSPI bytes=%u, transfers=%u>", self->bytes, self->transfers);
+}
+
+//
+//	stats() returns a dict of the counters recorded since the last reset()
+//
+
+static mp_obj_t mockspi_stats(mp_obj_t self_in) {
+	mockspi_obj_t *self = MP_OBJ_TO_PTR(self_in);
+	mp_obj_t dict = mp_obj_new_dict(11);
+
+	mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_bytes), mp_obj_new_int_from_uint(self->bytes));
+	mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_cmd_bytes), mp_obj_new_int_from_uint(self->cmd_bytes));
+	mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_data_bytes), mp_obj_new_int_from_uint(self->data_bytes));
+	mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_transfers), mp_obj_new_int_from_uint(self->transfers));
+	mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_cs_toggles), mp_obj_new_int_from_uint(self->cs_toggles));
+	mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_dc_toggles), mp_obj_new_int_from_uint(self->dc_toggles));
+	mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_cmds), mp_obj_new_int_from_uint(self->cmds));
+	mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_caset), mp_obj_new_int_from_uint(self->caset));
+	mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_paset), mp_obj_new_int_from_uint(self->paset));
+	mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_ramwr), mp_obj_new_int_from_uint(self->ramwr));
+	mp_obj_dict_store(dict, MP_OBJ_NEW_QSTR(MP_QSTR_cs_overlaps), mp_obj_new_int_from_uint(self->cs_overlaps));
+	return dict;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(mockspi_stats_obj, mockspi_stats);
+
+static mp_obj_t mockspi_reset(mp_obj_t self_in) {
+	mockspi_obj_t *self = MP_OBJ_TO_PTR(self_in);
+	mockspi_clear(self);
+	return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(mockspi_reset_obj, mockspi_reset);
+
+//
+//	write(buf) so the mock can stand in for machine.SPI in python code
+//
+
+static mp_obj_t mockspi_write(mp_obj_t self_in, mp_obj_t buf_in) {
+	mp_buffer_info_t bufinfo;
+	mp_get_buffer_raise(buf_in, &bufinfo, MP_BUFFER_READ);
+	mockspi_transfer(MP_OBJ_TO_PTR(self_in), bufinfo.len, bufinfo.buf, NULL);
+	return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_2(mockspi_write_obj, mockspi_write);
+
+static mp_obj_t mockspi_deinit(mp_obj_t self_in) {
+	(void) self_in;
+	return mp_const_none;
+}
+static MP_DEFINE_CONST_FUN_OBJ_1(mockspi_deinit_obj, mockspi_deinit);
+
+static mp_obj_t mockspi_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *all_args) {
+	enum { ARG_baudrate };
+	static const mp_arg_t allowed_args[] = {
+		{MP_QSTR_baudrate, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 0}},
+	};
+	mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+	mp_arg_parse_all_kw_array(n_args, n_kw, all_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+	mockspi_obj_t *self = m_new_obj(mockspi_obj_t);
+	memset(self, 0, sizeof(*self));
+	self->base.type = &ili9342c_MockSPI_type;
+	self->baudrate = args[ARG_baudrate].u_int;
+	self->busy_until = mp_hal_ticks_us();
+	self->cs = 1;
+	return MP_OBJ_FROM_PTR(self);
+}
+
+static const mp_machine_spi_p_t mockspi_p = {
+	.transfer = mockspi_transfer,
+};
+
+static const mp_rom_map_elem_t mockspi_locals_dict_table[] = {
+	{MP_ROM_QSTR(MP_QSTR_stats), MP_ROM_PTR(&mockspi_stats_obj)},
+	{MP_ROM_QSTR(MP_QSTR_reset), MP_ROM_PTR(&mockspi_reset_obj)},
+	{MP_ROM_QSTR(MP_QSTR_write), MP_ROM_PTR(&mockspi_write_obj)},
+	{MP_ROM_QSTR(MP_QSTR_deinit), MP_ROM_PTR(&mockspi_deinit_obj)},
+};
+static MP_DEFINE_CONST_DICT(mockspi_locals_dict, mockspi_locals_dict_table);
+
+#ifdef MP_OBJ_TYPE_GET_SLOT
+
+MP_DEFINE_CONST_OBJ_TYPE(
+	ili9342c_MockSPI_type,
+	MP_QSTR_MockSPI,
+	MP_TYPE_FLAG_NONE,
+	print, mockspi_print,
+	make_new, mockspi_make_new,
+	protocol, &mockspi_p,
+	locals_dict, (mp_obj_dict_t *) &mockspi_locals_dict);
+
+#else
+
+const mp_obj_type_t ili9342c_MockSPI_type = {
+	{&mp_type_type},
+	.name		 = MP_QSTR_MockSPI,
+	.print		 = mockspi_print,
+	.make_new	 = mockspi_make_new,
+	.protocol	 = &mockspi_p,
+	.locals_dict = (mp_obj_dict_t *) &mockspi_locals_dict,
+};
+
+#endif
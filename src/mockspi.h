@@ -0,0 +1,59 @@
+#ifndef __MOCKSPI_H__
+#define __MOCKSPI_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Recording SPI bus for building the driver on the unix port. Every byte the
+// driver would put on the wire is counted instead of sent, along with the
+// transfer calls, CS/DC pin changes and the window commands, and displays
+// sharing the bus are checked never to be selected together. Given a
+// baudrate, each transfer also takes as long as it would on the wire, and
+// mockspi_start() lets it run on while python carries on.
+//
+
+// CS pins tracked on one bus
+#define MOCKSPI_DEVICES 8
+
+typedef struct _mockspi_obj_t {
+	mp_obj_base_t	base;
+	uint32_t		bytes;			// total bytes transferred
+	uint32_t		cmd_bytes;		// bytes sent with DC low
+	uint32_t		data_bytes;		// bytes sent with DC high
+	uint32_t		transfers;		// protocol transfer() calls
+	uint32_t		cs_toggles;		// CS level changes
+	uint32_t		dc_toggles;		// DC level changes
+	uint32_t		cmds;			// command bytes sent
+	uint32_t		caset;			// CASET commands
+	uint32_t		paset;			// PASET commands
+	uint32_t		ramwr;			// RAMWR commands
+	uint32_t		cs_overlaps;	// CS asserted with another device selected
+	uint32_t		baudrate;		// simulated bus speed, 0 to take no time
+	mp_uint_t		busy_until;		// ticks_us() the last transfer completes
+	mp_obj_t		cs_pins[MOCKSPI_DEVICES];	// CS pins seen
+	uint8_t			cs_low;			// bit set for each cs_pins asserted
+	uint8_t			cs;				// current CS level, low if any device is selected
+	uint8_t			dc;				// current DC level
+} mockspi_obj_t;
+
+extern const mp_obj_type_t ili9342c_MockSPI_type;
+
+void mockspi_cs_write(mp_obj_base_t *spi_obj, mp_obj_t pin, int value);
+void mockspi_dc_write(mp_obj_base_t *spi_obj, int value);
+void mockspi_start(mp_obj_base_t *spi_obj, const uint8_t *buf, size_t len);
+void mockspi_wait(mp_obj_base_t *spi_obj);
+
+// The unix port has no machine.Pin, so any object is accepted as a pin and
+// only the CS and DC changes are recorded, by the mock bus itself.
+
+typedef mp_obj_t mp_hal_pin_obj_t;
+#define mp_hal_get_pin_obj(o) (o)
+#define mp_hal_pin_write(p, v) ((void) (p), (void) (v))
+
+#ifdef __cplusplus
+}
+#endif /*  __cplusplus */
+
+#endif  /*  __MOCKSPI_H__ */
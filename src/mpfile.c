@@ -27,6 +27,7 @@
 #include "py/builtin.h"
 #include "py/misc.h"
 #include "py/runtime.h"
+#include "py/mperrno.h"
 #include "mpfile.h"
 
 #include <string.h>
@@ -34,11 +35,41 @@
 static const mp_obj_type_t mp_file_type;
 static mp_obj_t mp___del__(mp_obj_t self);
 
+// Objects implementing the stream protocol, such as files, sockets and
+// BytesIO, are read and seeked through it without allocating. Any other
+// file-like object is called through its readinto, seek and tell methods.
+static const mp_stream_p_t *mp_file_stream(mp_obj_t file_obj) {
+    if (!mp_obj_is_obj(file_obj)) {
+        return NULL;
+    }
+    const mp_stream_p_t *stream_p = mp_get_stream(file_obj);
+    if (stream_p == NULL || stream_p->read == NULL) {
+        return NULL;
+    }
+    return stream_p;
+}
+
+static off_t mp_stream_seek(mp_file_t *file, off_t offset, int whence) {
+    struct mp_stream_seek_t seek_s;
+    int errcode;
+
+    if (file->stream_p->ioctl == NULL) {
+        mp_raise_OSError(MP_EOPNOTSUPP);
+    }
+    seek_s.offset = offset;
+    seek_s.whence = whence;
+    if (file->stream_p->ioctl(file->file_obj, MP_STREAM_SEEK, (uintptr_t)&seek_s, &errcode) == MP_STREAM_ERROR) {
+        mp_raise_OSError(errcode);
+    }
+    return seek_s.offset;
+}
+
 mp_file_t *mp_file_from_file_obj(mp_obj_t file_obj) {
     mp_file_t *file = m_new_obj(mp_file_t);
     memset(file, 0, sizeof(*file));
     file->base.type = &mp_file_type;
     file->file_obj = file_obj;
+    file->stream_p = mp_file_stream(file_obj);
     file->readinto_fn = mp_const_none;
     file->seek_fn = mp_const_none;
     file->tell_fn = mp_const_none;
@@ -56,6 +87,15 @@ mp_file_t *mp_open(const char *filename, const char *mode) {
 mp_int_t mp_readinto(mp_file_t *file, void *buf, size_t num_bytes) {
     mp_int_t nread;
 
+    if (file->stream_p) {
+        int errcode;
+        mp_uint_t out_sz = mp_stream_rw(file->file_obj, buf, num_bytes, &errcode, MP_STREAM_RW_READ);
+        if (out_sz == MP_STREAM_ERROR) {
+            mp_raise_OSError(errcode);
+        }
+        return out_sz;
+    }
+
     if (file->readinto_fn == mp_const_none) {
         file->readinto_fn = mp_load_attr(file->file_obj, MP_QSTR_readinto);
     }
@@ -70,6 +110,9 @@ mp_int_t mp_readinto(mp_file_t *file, void *buf, size_t num_bytes) {
 }
 
 off_t mp_seek(mp_file_t *file, off_t offset, int whence) {
+    if (file->stream_p) {
+        return mp_stream_seek(file, offset, whence);
+    }
     if (file->seek_fn == mp_const_none) {
         file->seek_fn = mp_load_attr(file->file_obj, MP_QSTR_seek);
     }
@@ -79,6 +122,9 @@ off_t mp_seek(mp_file_t *file, off_t offset, int whence) {
 }
 
 off_t mp_tell(mp_file_t *file) {
+    if (file->stream_p) {
+        return mp_stream_seek(file, 0, MP_SEEK_CUR);
+    }
     if (file->tell_fn == mp_const_none) {
         file->tell_fn = mp_load_attr(file->file_obj, MP_QSTR_tell);
     }
@@ -89,6 +135,7 @@ void mp_close(mp_file_t *file) {
 
     mp_obj_t close_fn = mp_load_attr(file->file_obj, MP_QSTR_close);
     file->file_obj = mp_const_none;
+    file->stream_p = NULL;
     file->readinto_fn = mp_const_none;
     file->seek_fn = mp_const_none;
     file->tell_fn = mp_const_none;
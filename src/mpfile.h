@@ -28,6 +28,7 @@
 #define __MICROPY_INCLUDED_PY_MPFILE_H__
 
 #include "py/obj.h"
+#include "py/stream.h"
 #include <sys/types.h>  // for off_t
 
 // A C API for performing I/O on files or file-like objects.
@@ -35,6 +36,7 @@
 typedef struct {
     mp_obj_base_t   base;
     mp_obj_t        file_obj;
+    const mp_stream_p_t *stream_p;  // called directly when not NULL
     mp_obj_t        readinto_fn;
     mp_obj_t        seek_fn;
     mp_obj_t        tell_fn;
@@ -38,6 +38,48 @@ static const uint8_t Zig[64] = {	/* Zigzag-order to raster-order conversion tabl
 
 
 
+/*-------------------------------------------------*/
+/* Huffman tables of JPEG Annex K.3 in DHT format, */
+/* used by streams without a DHT segment (MJPEG)   */
+/*-------------------------------------------------*/
+
+static const uint8_t Dht[] = {
+	0x00,	/* DC luminance */
+	0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0,
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B,
+	0x10,	/* AC luminance */
+	0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 125,
+	0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+	0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08, 0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0,
+	0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+	0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+	0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+	0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+	0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7,
+	0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5,
+	0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+	0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+	0xF9, 0xFA,
+	0x01,	/* DC chrominance */
+	0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0,
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B,
+	0x11,	/* AC chrominance */
+	0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 119,
+	0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+	0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xA1, 0xB1, 0xC1, 0x09, 0x23, 0x33, 0x52, 0xF0,
+	0x15, 0x62, 0x72, 0xD1, 0x0A, 0x16, 0x24, 0x34, 0xE1, 0x25, 0xF1, 0x17, 0x18, 0x19, 0x1A, 0x26,
+	0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+	0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+	0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+	0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5,
+	0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3,
+	0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA,
+	0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+	0xF9, 0xFA
+};
+
+
+
 /*-------------------------------------------------*/
 /* Input scale factor of Arai algorithm            */
 /* (scaled up 16 bits for fixed point operations)  */
@@ -120,6 +162,14 @@ inline uint8_t BYTECLIP (
 #endif
 
 
+/* Use the tuned IDCT and color conversion, they give the same output as the reference ones */
+#if JD_REFKERNEL
+#define FASTKERNEL(jd)	(JD_FASTKERNEL && !(jd)->refkernel)
+#else
+#define FASTKERNEL(jd)	JD_FASTKERNEL
+#endif
+
+
 
 /*-----------------------------------------------------------------------*/
 /* Allocate a memory block from memory pool                              */
@@ -191,6 +241,11 @@ static JRESULT create_huffman_tbl (	/* 0:OK, !0:Failed */
 	unsigned int i, j, b, np, cls, num;
 	uint8_t d, *pb, *pd;
 	uint16_t hc, *ph;
+#if JD_FASTDECODE
+	unsigned int ti, span;
+	uint8_t *ldc;
+	uint16_t *lac;
+#endif
 
 
 	while (ndata) {	/* Process all tables in the segment */
@@ -225,14 +280,198 @@ static JRESULT create_huffman_tbl (	/* 0:OK, !0:Failed */
 			if (!cls && d > 11) return JDR_FMT1;
 			*pd++ = d;
 		}
+
+#if JD_FASTDECODE
+		/* Expand the codes of up to JD_HUFFBITS bits into a table indexed by the next JD_HUFFBITS bits of the stream */
+		ldc = 0; lac = 0;
+		if (cls) {
+			lac = alloc_pool(jd, (1 << JD_HUFFBITS) * sizeof (uint16_t));
+			if (!lac) return JDR_MEM1;		/* Err: not enough memory */
+			jd->hufflut_ac[num] = lac;
+			for (i = 0; i < (1 << JD_HUFFBITS); lac[i++] = 0xFFFF) ;	/* 0xFFFF: longer code */
+		} else {
+			ldc = alloc_pool(jd, 1 << JD_HUFFBITS);
+			if (!ldc) return JDR_MEM1;		/* Err: not enough memory */
+			jd->hufflut_dc[num] = ldc;
+			for (i = 0; i < (1 << JD_HUFFBITS); ldc[i++] = 0xFF) ;	/* 0xFF: longer code */
+		}
+		pd = jd->huffdata[num][cls];
+		for (j = b = 0; b < JD_HUFFBITS; b++) {	/* Code length b + 1 */
+			span = 1 << (JD_HUFFBITS - 1 - b);	/* Number of entries sharing the code as their top bits */
+			for (i = pb[b]; i; i--, j++) {
+				ti = (unsigned int)ph[j] << (JD_HUFFBITS - 1 - b);
+				if (ti + span > (1 << JD_HUFFBITS)) return JDR_FMT1;	/* Err: code does not fit its length (broken table) */
+				for (np = span; np; np--, ti++) {
+					if (cls) {
+						lac[ti] = (uint16_t)((b + 1) << 8 | pd[j]);
+					} else {
+						ldc[ti] = (uint8_t)((b + 1) << 4 | pd[j]);
+					}
+				}
+			}
+		}
+#endif
+	}
+
+	return JDR_OK;
+}
+
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Re-fill the input buffer, or point at the stream in memory            */
+/*-----------------------------------------------------------------------*/
+
+static unsigned int refill (	/* Number of bytes available at *dp (0:read error or end of stream) */
+	JDEC* jd,		/* Pointer to the decompressor object */
+	uint8_t** dp	/* Receives the read ptr */
+)
+{
+#if JD_FASTDECODE
+	if (jd->inref) return jd->inref(jd, dp);	/* Read the stream in place, the bit stream is never written */
+#endif
+	*dp = jd->inbuf;	/* Top of input buffer */
+	return jd->infunc(jd, *dp, jd->sz_buf);
+}
+
+
+
+
+#if JD_FASTDECODE
+
+/*-----------------------------------------------------------------------*/
+/* Load the working register with at least N bits from input stream      */
+/*-----------------------------------------------------------------------*/
+
+static JRESULT fillbits (	/* 0:OK, !0:Failed */
+	JDEC* jd,			/* Pointer to the decompressor object */
+	unsigned int nbit	/* Number of bits needed (1 to 16) */
+)
+{
+	uint8_t d, *dp;
+	unsigned int dc, dbit;
+	uint32_t w;
+
+
+	w = jd->wreg; dbit = jd->dbit; dc = jd->dctr; dp = jd->dptr;	/* Working register, number of data available, read ptr */
+
+	while (dbit < nbit) {
+		d = 0xFF;				/* Stuff bits once the stream has stopped at a marker */
+		if (!jd->marker) {
+			if (!dc) {			/* No input data is available, re-fill input buffer */
+				dc = refill(jd, &dp);
+				if (!dc) return JDR_INP;	/* Err: read error or wrong stream termination */
+			} else {
+				dp++;			/* Next data ptr */
+			}
+			dc--;				/* Decrement number of available bytes */
+			d = *dp;			/* Get next data byte */
+			if (d == 0xFF) {	/* Is start of flag sequence? Get trailing byte */
+				if (!dc) {
+					dc = refill(jd, &dp);
+					if (!dc) return JDR_INP;
+				} else {
+					dp++;
+				}
+				dc--;
+				jd->marker = *dp;	/* 0: The flag is a data 0xFF, others: a marker ends the bit stream */
+			}
+		}
+		w = w << 8 | d;			/* Put the byte into the working register */
+		dbit += 8;
 	}
 
+	jd->wreg = w; jd->dbit = (uint8_t)dbit; jd->dctr = dc; jd->dptr = dp;
+
 	return JDR_OK;
 }
 
 
 
 
+/*-----------------------------------------------------------------------*/
+/* Extract N bits from input stream                                      */
+/*-----------------------------------------------------------------------*/
+
+static int bitext (	/* >=0: extracted data, <0: error code */
+	JDEC* jd,			/* Pointer to the decompressor object */
+	unsigned int nbit	/* Number of bits to extract (1 to 11) */
+)
+{
+	JRESULT rc;
+
+
+	if (jd->dbit < nbit) {
+		rc = fillbits(jd, nbit);
+		if (rc) return 0 - (int)rc;	/* Err: input */
+	}
+	jd->dbit -= nbit;
+
+	return (int)(jd->wreg >> jd->dbit & ((1UL << nbit) - 1));
+}
+
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Extract a huffman decoded data from input stream                      */
+/*-----------------------------------------------------------------------*/
+
+static int huffext (		/* >=0: decoded data, <0: error code */
+	JDEC* jd,				/* Pointer to the decompressor object */
+	unsigned int id,		/* Huffman table ID */
+	unsigned int cls		/* Huffman table class 0:DC, 1:AC */
+)
+{
+	const uint8_t *hbits, *hdata;
+	const uint16_t *hcode;
+	unsigned int v, bl, nd;
+	JRESULT rc;
+
+
+	if (jd->dbit < 16) {	/* Make sure the longest code is in the working register */
+		rc = fillbits(jd, 16);
+		if (rc) return 0 - (int)rc;	/* Err: input */
+	}
+
+	/* Look up codes of up to JD_HUFFBITS bits */
+	v = (unsigned int)(jd->wreg >> (jd->dbit - JD_HUFFBITS)) & ((1 << JD_HUFFBITS) - 1);
+	if (cls) {
+		v = jd->hufflut_ac[id][v];
+		if (v != 0xFFFF) {
+			jd->dbit -= v >> 8;
+			return (int)(v & 0xFF);
+		}
+	} else {
+		v = jd->hufflut_dc[id][v];
+		if (v != 0xFF) {
+			jd->dbit -= v >> 4;
+			return (int)(v & 0x0F);
+		}
+	}
+
+	/* Search the longer codes in the code word table */
+	hbits = jd->huffbits[id][cls]; hcode = jd->huffcode[id][cls]; hdata = jd->huffdata[id][cls];
+	for (bl = 0; bl < JD_HUFFBITS; bl++) {	/* Skip the codes found in the lookup table */
+		nd = *hbits++; hcode += nd; hdata += nd;
+	}
+	for (bl = JD_HUFFBITS + 1; bl <= 16; bl++) {
+		v = (unsigned int)(jd->wreg >> (jd->dbit - bl)) & ((1UL << bl) - 1);
+		for (nd = *hbits++; nd; nd--) {	/* Search the code word in this bit length */
+			if (v == *hcode++) {		/* Matched? */
+				jd->dbit -= bl;
+				return *hdata;			/* Return the decoded data */
+			}
+			hdata++;
+		}
+	}
+
+	return 0 - (int)JDR_FMT1;	/* Err: code not found (may be collapted data) */
+}
+
+#else
+
 /*-----------------------------------------------------------------------*/
 /* Extract N bits from input stream                                      */
 /*-----------------------------------------------------------------------*/
@@ -252,8 +491,7 @@ static int bitext (	/* >=0: extracted data, <0: error code */
 	do {
 		if (!msk) {				/* Next byte? */
 			if (!dc) {			/* No input data is available, re-fill input buffer */
-				dp = jd->inbuf;	/* Top of input buffer */
-				dc = jd->infunc(jd, dp, JD_SZBUF);
+				dc = refill(jd, &dp);
 				if (!dc) return 0 - (int)JDR_INP;	/* Err: read error or wrong stream termination */
 			} else {
 				dp++;			/* Next data ptr */
@@ -291,11 +529,12 @@ static int bitext (	/* >=0: extracted data, <0: error code */
 
 static int huffext (		/* >=0: decoded data, <0: error code */
 	JDEC* jd,				/* Pointer to the decompressor object */
-	const uint8_t* hbits,	/* Pointer to the bit distribution table */
-	const uint16_t* hcode,	/* Pointer to the code word table */
-	const uint8_t* hdata	/* Pointer to the data table */
+	unsigned int id,		/* Huffman table ID */
+	unsigned int cls		/* Huffman table class 0:DC, 1:AC */
 )
 {
+	const uint8_t *hbits = jd->huffbits[id][cls], *hdata = jd->huffdata[id][cls];
+	const uint16_t *hcode = jd->huffcode[id][cls];
 	uint8_t msk, s, *dp;
 	unsigned int dc, v, f, bl, nd;
 
@@ -306,8 +545,7 @@ static int huffext (		/* >=0: decoded data, <0: error code */
 	do {
 		if (!msk) {		/* Next byte? */
 			if (!dc) {	/* No input data is available, re-fill input buffer */
-				dp = jd->inbuf;	/* Top of input buffer */
-				dc = jd->infunc(jd, dp, JD_SZBUF);
+				dc = refill(jd, &dp);
 				if (!dc) return 0 - (int)JDR_INP;	/* Err: read error or wrong stream termination */
 			} else {
 				dp++;	/* Next data ptr */
@@ -342,6 +580,8 @@ static int huffext (		/* >=0: decoded data, <0: error code */
 	return 0 - (int)JDR_FMT1;	/* Err: code not found (may be collapted data) */
 }
 
+#endif
+
 
 
 
@@ -351,16 +591,25 @@ static int huffext (		/* >=0: decoded data, <0: error code */
 
 static void block_idct (
 	int32_t* src,	/* Input block data (de-quantized and pre-scaled for Arai Algorithm) */
-	uint8_t* dst	/* Pointer to the destination to store the block as byte array */
+	uint8_t* dst,	/* Pointer to the destination to store the block as byte array */
+	int fast		/* 1:Skip the transform of columns and rows with only a DC element */
 )
 {
 	const int32_t M13 = (int32_t)(1.41421*4096), M2 = (int32_t)(1.08239*4096), M4 = (int32_t)(2.61313*4096), M5 = (int32_t)(1.84776*4096);
 	int32_t v0, v1, v2, v3, v4, v5, v6, v7;
 	int32_t t10, t11, t12, t13;
+	uint8_t d;
 	int i;
 
 	/* Process columns */
 	for (i = 0; i < 8; i++) {
+		if (fast && !(src[8 * 1] | src[8 * 2] | src[8 * 3] | src[8 * 4] | src[8 * 5] | src[8 * 6] | src[8 * 7])) {
+			/* All of the column transforms to its DC element */
+			src[8 * 1] = src[8 * 2] = src[8 * 3] = src[8 * 4] = src[8 * 5] = src[8 * 6] = src[8 * 7] = src[8 * 0];
+			src++;	/* Next column */
+			continue;
+		}
+
 		v0 = src[8 * 0];	/* Get even elements */
 		v1 = src[8 * 2];
 		v2 = src[8 * 4];
@@ -408,6 +657,15 @@ static void block_idct (
 	/* Process rows */
 	src -= 8;
 	for (i = 0; i < 8; i++) {
+		if (fast && !(src[1] | src[2] | src[3] | src[4] | src[5] | src[6] | src[7])) {
+			/* All of the row transforms to its DC element */
+			d = BYTECLIP((src[0] + (128L << 8)) >> 8);
+			dst[0] = dst[1] = dst[2] = dst[3] = dst[4] = dst[5] = dst[6] = dst[7] = d;
+			dst += 8;
+			src += 8;	/* Next row */
+			continue;
+		}
+
 		v0 = src[0] + (128L << 8);	/* Get even elements (remove DC offset (-128) here) */
 		v1 = src[2];
 		v2 = src[4];
@@ -462,15 +720,14 @@ static void block_idct (
 /*-----------------------------------------------------------------------*/
 
 static JRESULT mcu_load (
-	JDEC* jd		/* Pointer to the decompressor object */
+	JDEC* jd,		/* Pointer to the decompressor object */
+	int idct		/* 0:Only extract the MCU from the stream, it is not output */
 )
 {
 	int32_t *tmp = (int32_t*)jd->workbuf;	/* Block working buffer for de-quantize and IDCT */
 	int b, d, e;
 	unsigned int blk, nby, nbc, i, z, id, cmp;
 	uint8_t *bp;
-	const uint8_t *hb, *hd;
-	const uint16_t *hc;
 	const int32_t *dqf;
 
 
@@ -483,10 +740,7 @@ static JRESULT mcu_load (
 		id = cmp ? 1 : 0;						/* Huffman table ID of the component */
 
 		/* Extract a DC element from input stream */
-		hb = jd->huffbits[id][0];				/* Huffman table for the DC element */
-		hc = jd->huffcode[id][0];
-		hd = jd->huffdata[id][0];
-		b = huffext(jd, hb, hc, hd);			/* Extract a huffman coded data (bit length) */
+		b = huffext(jd, id, 0);					/* Extract a huffman coded data (bit length) */
 		if (b < 0) return 0 - b;				/* Err: invalid code or input */
 		d = jd->dcv[cmp];						/* DC value of previous block */
 		if (b) {								/* If there is any difference from previous block */
@@ -502,12 +756,9 @@ static JRESULT mcu_load (
 
 		/* Extract following 63 AC elements from input stream */
 		for (i = 1; i < 64; tmp[i++] = 0) ;		/* Clear rest of elements */
-		hb = jd->huffbits[id][1];				/* Huffman table for the AC elements */
-		hc = jd->huffcode[id][1];
-		hd = jd->huffdata[id][1];
 		i = 1;					/* Top of the AC elements */
 		do {
-			b = huffext(jd, hb, hc, hd);		/* Extract a huffman coded value (zero runs and bit length) */
+			b = huffext(jd, id, 1);				/* Extract a huffman coded value (zero runs and bit length) */
 			if (b == 0) break;					/* EOB? */
 			if (b < 0) return 0 - b;			/* Err: invalid code or input error */
 			z = (unsigned int)b >> 4;			/* Number of leading zero elements */
@@ -525,10 +776,12 @@ static JRESULT mcu_load (
 			}
 		} while (++i < 64);		/* Next AC element */
 
-		if (JD_USE_SCALE && jd->scale == 3) {
+		if (!idct) {
+			/* The MCU is skipped, only the stream position and DC values matter */
+		} else if (JD_USE_SCALE && jd->scale == 3) {
 			*bp = (uint8_t)((*tmp / 256) + 128);	/* If scale ratio is 1/8, IDCT can be ommited and only DC element is used */
 		} else {
-			block_idct(tmp, bp);		/* Apply IDCT and store the block to the MCU buffer */
+			block_idct(tmp, bp, FASTKERNEL(jd));	/* Apply IDCT and store the block to the MCU buffer */
 		}
 
 		bp += 64;				/* Next block */
@@ -540,6 +793,32 @@ static JRESULT mcu_load (
 
 
 
+/*-----------------------------------------------------------------------*/
+/* Convert a YCbCr pixel to RGB565 with the chroma terms given           */
+/*-----------------------------------------------------------------------*/
+
+static uint16_t ycc_rgb565 (	/* RGB565 pixel, byte swapped for the display */
+	int yy,			/* Y component */
+	int rr,			/* Cr term of R */
+	int gg,			/* Cb and Cr terms of G */
+	int bb			/* Cb term of B */
+)
+{
+	int r = yy + rr, g = yy - gg, b = yy + bb;
+	unsigned int w;
+
+
+	if ((unsigned int)(r | g | b) > 255) {	/* Saturate only when a component is out of range */
+		r = BYTECLIP(r); g = BYTECLIP(g); b = BYTECLIP(b);
+	}
+	w = (r & 0xF8) << 8 | (g & 0xFC) << 3 | b >> 3;	/* RRRRRGGGGGGBBBBB */
+
+	return (uint16_t)(w >> 8 | w << 8);
+}
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Output an MCU: Convert YCrCb to RGB and output it in RGB form         */
 /*-----------------------------------------------------------------------*/
@@ -569,6 +848,48 @@ static JRESULT mcu_output (
 	rect.left = x; rect.right = x + rx - 1;				/* Rectangular area in the frame buffer */
 	rect.top = y; rect.bottom = y + ry - 1;
 
+	if (JD_FORMAT == 1 && FASTKERNEL(jd) && (!JD_USE_SCALE || jd->scale == 0 || jd->scale == 3)) {
+		/* Convert only the output pixels straight to RGB565, computing the chroma terms once for the pixels sharing them */
+		uint16_t *op = (uint16_t*)jd->workbuf;
+		unsigned int sx, sy, jx, jy, ex, ey;
+		int rr, gg, bb;
+
+		pc = jd->mcubuf + 64 * jd->msx * jd->msy;	/* Cb block, followed by the Cr block */
+		if (!JD_USE_SCALE || jd->scale == 0) {
+			sx = jd->msx - 1; sy = jd->msy - 1;			/* Chroma subsampling shifts */
+			for (iy = 0; iy < ry; iy += 1 << sy) {
+				ey = (iy + (1 << sy) < ry) ? iy + (1 << sy) : ry;
+				for (ix = 0; ix < rx; ix += 1 << sx) {
+					ex = (ix + (1 << sx) < rx) ? ix + (1 << sx) : rx;
+					cb = pc[(iy >> sy) * 8 + (ix >> sx)] - 128;	/* Get Cb/Cr component and restore right level */
+					cr = pc[(iy >> sy) * 8 + (ix >> sx) + 64] - 128;
+					rr = ((int)(1.402 * CVACC) * cr) / CVACC;
+					gg = ((int)(0.344 * CVACC) * cb + (int)(0.714 * CVACC) * cr) / CVACC;
+					bb = ((int)(1.772 * CVACC) * cb) / CVACC;
+					for (jy = iy; jy < ey; jy++) {
+						py = jd->mcubuf + (jy & 8) * 16 + (jy & 7) * 8;	/* Row of the Y block(s) */
+						for (jx = ix; jx < ex; jx++) {
+							op[jy * rx + jx] = ycc_rgb565(py[(jx & 8) * 8 + (jx & 7)], rr, gg, bb);
+						}
+					}
+				}
+			}
+		} else {	/* For 1/8 scaling, a pixel from the DC value of each Y block */
+			cb = pc[0] - 128;
+			cr = pc[64] - 128;
+			rr = ((int)(1.402 * CVACC) * cr) / CVACC;
+			gg = ((int)(0.344 * CVACC) * cb + (int)(0.714 * CVACC) * cr) / CVACC;
+			bb = ((int)(1.772 * CVACC) * cb) / CVACC;
+			for (iy = 0; iy < ry; iy++) {
+				for (ix = 0; ix < rx; ix++) {
+					*op++ = ycc_rgb565(jd->mcubuf[64 * (iy * jd->msx + ix)], rr, gg, bb);
+				}
+			}
+		}
+
+		return outfunc(jd, jd->workbuf, &rect) ? JDR_OK : JDR_INTR;
+	}
+
 
 	if (!JD_USE_SCALE || jd->scale != 3) {	/* Not for 1/8 scaling */
 
@@ -709,10 +1030,16 @@ static JRESULT restart (
 	/* Discard padding bits and get two bytes from the input stream */
 	dp = jd->dptr; dc = jd->dctr;
 	d = 0;
+#if JD_FASTDECODE
+	jd->wreg = 0; jd->dbit = 0;
+	if (jd->marker) {	/* The marker has been read with the padding bits */
+		d = 0xFF00 | jd->marker;
+		jd->marker = 0;
+	} else
+#endif
 	for (i = 0; i < 2; i++) {
 		if (!dc) {	/* No input data is available, re-fill input buffer */
-			dp = jd->inbuf;
-			dc = jd->infunc(jd, dp, JD_SZBUF);
+			dc = refill(jd, &dp);
 			if (!dc) return JDR_INP;
 		} else {
 			dp++;
@@ -720,7 +1047,11 @@ static JRESULT restart (
 		dc--;
 		d = (d << 8) | *dp;	/* Get a byte */
 	}
+#if JD_FASTDECODE
+	jd->dptr = dp; jd->dctr = dc;
+#else
 	jd->dptr = dp; jd->dctr = dc; jd->dmsk = 0;
+#endif
 
 	/* Check the marker */
 	if ((d & 0xFFD8) != 0xFFD0 || (d & 7) != (rstn & 7)) {
@@ -747,6 +1078,7 @@ JRESULT jd_prepare (
 	unsigned int (*infunc)(JDEC*, uint8_t*, unsigned int),	/* JPEG strem input function */
 	void* pool,				/* Working buffer for the decompression session */
 	unsigned int sz_pool,	/* Size of working buffer */
+	unsigned int sz_buf,	/* Size of stream input buffer, at least JD_SZBUF */
 	void* dev				/* I/O device identifier for the session */
 )
 {
@@ -757,13 +1089,17 @@ JRESULT jd_prepare (
 	JRESULT rc;
 
 
-	if (!pool) return JDR_PAR;
+	if (!pool || sz_buf < JD_SZBUF) return JDR_PAR;
 
 	jd->pool = pool;		/* Work memroy */
 	jd->sz_pool = sz_pool;	/* Size of given work memory */
 	jd->infunc = infunc;	/* Stream input function */
+	jd->inref = 0;			/* No in-place input function unless the application sets one */
 	jd->device = dev;		/* I/O device identifier */
 	jd->nrst = 0;			/* No restart interval (default) */
+#if JD_REFKERNEL
+	jd->refkernel = 0;		/* Tuned IDCT and color conversion (default) */
+#endif
 
 	for (i = 0; i < 2; i++) {	/* Nulls pointers */
 		for (j = 0; j < 2; j++) {
@@ -774,7 +1110,8 @@ JRESULT jd_prepare (
 	}
 	for (i = 0; i < 4; jd->qttbl[i++] = 0) ;
 
-	jd->inbuf = seg = alloc_pool(jd, JD_SZBUF);		/* Allocate stream input buffer */
+	jd->sz_buf = sz_buf;	/* Size of stream input buffer */
+	jd->inbuf = seg = alloc_pool(jd, sz_buf);		/* Allocate stream input buffer */
 	if (!seg) return JDR_MEM1;
 
 	if (jd->infunc(jd, seg, 2) != 2) return JDR_INP;/* Check SOI marker */
@@ -793,7 +1130,7 @@ JRESULT jd_prepare (
 		switch (marker & 0xFF) {
 		case 0xC0:	/* SOF0 (baseline JPEG) */
 			/* Load segment data */
-			if (len > JD_SZBUF) return JDR_MEM2;
+			if (len > jd->sz_buf) return JDR_MEM2;
 			if (jd->infunc(jd, seg, len) != len) return JDR_INP;
 
 			jd->width = LDB_WORD(seg+3);		/* Image width in unit of pixel */
@@ -819,7 +1156,7 @@ JRESULT jd_prepare (
 
 		case 0xDD:	/* DRI */
 			/* Load segment data */
-			if (len > JD_SZBUF) return JDR_MEM2;
+			if (len > jd->sz_buf) return JDR_MEM2;
 			if (jd->infunc(jd, seg, len) != len) return JDR_INP;
 
 			/* Get restart interval (MCUs) */
@@ -828,7 +1165,7 @@ JRESULT jd_prepare (
 
 		case 0xC4:	/* DHT */
 			/* Load segment data */
-			if (len > JD_SZBUF) return JDR_MEM2;
+			if (len > jd->sz_buf) return JDR_MEM2;
 			if (jd->infunc(jd, seg, len) != len) return JDR_INP;
 
 			/* Create huffman tables */
@@ -838,7 +1175,7 @@ JRESULT jd_prepare (
 
 		case 0xDB:	/* DQT */
 			/* Load segment data */
-			if (len > JD_SZBUF) return JDR_MEM2;
+			if (len > jd->sz_buf) return JDR_MEM2;
 			if (jd->infunc(jd, seg, len) != len) return JDR_INP;
 			/* Create de-quantizer tables */
 			rc = create_qt_tbl(jd, seg, len);
@@ -847,13 +1184,19 @@ JRESULT jd_prepare (
 
 		case 0xDA:	/* SOS */
 			/* Load segment data */
-			if (len > JD_SZBUF) return JDR_MEM2;
+			if (len > jd->sz_buf) return JDR_MEM2;
 			if (jd->infunc(jd, seg, len) != len) return JDR_INP;
 
 			if (!jd->width || !jd->height) return JDR_FMT1;	/* Err: Invalid image size */
 
 			if (seg[0] != 3) return JDR_FMT3;				/* Err: Supports only three color components format */
 
+			/* Use the default huffman tables if the stream has no DHT segment */
+			if (!jd->huffbits[0][0] && !jd->huffbits[0][1] && !jd->huffbits[1][0] && !jd->huffbits[1][1]) {
+				rc = create_huffman_tbl(jd, Dht, sizeof Dht);
+				if (rc) return rc;
+			}
+
 			/* Check if all tables corresponding to each components have been loaded */
 			for (i = 0; i < 3; i++) {
 				b = seg[2 + 2 * i];	/* Get huffman table ID */
@@ -877,10 +1220,18 @@ JRESULT jd_prepare (
 			jd->mcubuf = (uint8_t*)alloc_pool(jd, (unsigned int)((n + 2) * 64));	/* Allocate MCU working buffer */
 			if (!jd->mcubuf) return JDR_MEM1;			/* Err: not enough memory */
 
+			/* Output the whole image unless a crop is set */
+			jd->crop.left = 0; jd->crop.right = jd->width - 1;
+			jd->crop.top = 0; jd->crop.bottom = jd->height - 1;
+
 			/* Pre-load the JPEG data to extract it from the bit stream */
+#if JD_FASTDECODE
+			jd->dptr = seg; jd->dctr = 0; jd->wreg = 0; jd->dbit = 0; jd->marker = 0;	/* Prepare to read bit stream */
+#else
 			jd->dptr = seg; jd->dctr = 0; jd->dmsk = 0;	/* Prepare to read bit stream */
-			if (ofs %= JD_SZBUF) {						/* Align read offset to JD_SZBUF */
-				jd->dctr = jd->infunc(jd, seg + ofs, (unsigned int)(JD_SZBUF - ofs));
+#endif
+			if (ofs %= jd->sz_buf) {					/* Align read offset to the buffer size */
+				jd->dctr = jd->infunc(jd, seg + ofs, (unsigned int)(jd->sz_buf - ofs));
 				jd->dptr = seg + ofs - 1;
 			}
 
@@ -911,6 +1262,34 @@ JRESULT jd_prepare (
 
 
 
+/*-----------------------------------------------------------------------*/
+/* Start the next JPEG picture of a stream with the same headers         */
+/*-----------------------------------------------------------------------*/
+
+JRESULT jd_next (
+	JDEC* jd,		/* Decompressor object initialized by jd_prepare */
+	void* dev		/* I/O device identifier, positioned after the SOS segment */
+)
+{
+	jd->device = dev;		/* I/O device identifier */
+
+	/* Output the whole image unless a crop is set */
+	jd->crop.left = 0; jd->crop.right = jd->width - 1;
+	jd->crop.top = 0; jd->crop.bottom = jd->height - 1;
+
+	/* Empty the input buffer and the bit stream */
+#if JD_FASTDECODE
+	jd->dptr = jd->inbuf; jd->dctr = 0; jd->wreg = 0; jd->dbit = 0; jd->marker = 0;
+#else
+	jd->dptr = jd->inbuf; jd->dctr = 0; jd->dmsk = 0;
+#endif
+
+	return JDR_OK;
+}
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Start to decompress the JPEG picture                                  */
 /*-----------------------------------------------------------------------*/
@@ -924,6 +1303,7 @@ JRESULT jd_decomp (
 	unsigned int x, y, mx, my;
 	uint16_t rst, rsc;
 	JRESULT rc;
+	int out;
 
 	if (scale > (JD_USE_SCALE ? 3 : 0)) return JDR_PAR;
 	jd->scale = scale;
@@ -934,17 +1314,20 @@ JRESULT jd_decomp (
 	rst = rsc = 0;
 
 	rc = JDR_OK;
-	for (y = 0; y < jd->height; y += my) {		/* Vertical loop of MCUs */
+	for (y = 0; y < jd->height && y <= jd->crop.bottom; y += my) {	/* Vertical loop of MCUs, up to the bottom of the crop */
 		for (x = 0; x < jd->width; x += mx) {	/* Horizontal loop of MCUs */
 			if (jd->nrst && rst++ == jd->nrst) {	/* Process restart interval if enabled */
 				rc = restart(jd, rsc++);
 				if (rc != JDR_OK) return rc;
 				rst = 1;
 			}
-			rc = mcu_load(jd);					/* Load an MCU (decompress huffman coded stream and apply IDCT) */
-			if (rc != JDR_OK) return rc;
-			rc = mcu_output(jd, outfunc, x, y);	/* Output the MCU (color space conversion, scaling and output) */
+			out = (x <= jd->crop.right && x + mx > jd->crop.left && y + my > jd->crop.top);	/* Is the MCU in the crop? */
+			rc = mcu_load(jd, out);				/* Load an MCU (decompress huffman coded stream and apply IDCT) */
 			if (rc != JDR_OK) return rc;
+			if (out) {
+				rc = mcu_output(jd, outfunc, x, y);	/* Output the MCU (color space conversion, scaling and output) */
+				if (rc != JDR_OK) return rc;
+			}
 		}
 	}
 
@@ -6,10 +6,26 @@
 /*---------------------------------------------------------------------------*/
 /* System Configurations */
 
-#define	JD_SZBUF		512	/* Size of stream input buffer */
+#define	JD_SZBUF		512	/* Default and minimum size of stream input buffer */
 #define JD_FORMAT		1	/* Output pixel format 0:RGB888 (3 BYTE/pix), 1:RGB565 (1 WORD/pix) */
 #define	JD_USE_SCALE	1	/* Use descaling feature for output */
 #define JD_TBLCLIP		1	/* Use table for saturation (might be a bit faster but increases 1K bytes of code size) */
+#ifndef JD_FASTDECODE
+#define JD_FASTDECODE	1	/* Huffman decoding 0:Bit by bit, 1:With lookup tables and a 32-bit bit register (JD_SZLUT more memory pool) */
+#endif
+#define JD_HUFFBITS		9	/* Longest code decoded with a single table lookup when JD_FASTDECODE is 1 */
+#ifndef JD_FASTKERNEL
+#define JD_FASTKERNEL	1	/* IDCT and color conversion 0:Reference, 1:Skip zero columns/rows and convert straight to RGB565 (same output) */
+#endif
+#ifndef JD_REFKERNEL
+#define JD_REFKERNEL	0	/* 1:Also keep the reference kernels, selected with JDEC.refkernel, to check JD_FASTKERNEL against */
+#endif
+
+#if JD_FASTDECODE
+#define JD_SZLUT		(6 << JD_HUFFBITS)	/* Memory pool used by the lookup tables, 2 DC (1 byte) and 2 AC (2 bytes) tables */
+#else
+#define JD_SZLUT		0
+#endif
 
 /*---------------------------------------------------------------------------*/
 
@@ -47,7 +63,14 @@ struct JDEC {
 	unsigned int dctr;			/* Number of bytes available in the input buffer */
 	uint8_t* dptr;				/* Current data read ptr */
 	uint8_t* inbuf;				/* Bit stream input buffer */
+	unsigned int sz_buf;		/* Size of the bit stream input buffer */
+#if JD_FASTDECODE
+	uint32_t wreg;				/* Bit stream working register */
+	uint8_t dbit;				/* Number of bits available in the working register */
+	uint8_t marker;				/* Marker that stopped the bit stream (0:None) */
+#else
 	uint8_t dmsk;				/* Current bit in the current read byte */
+#endif
 	uint8_t scale;				/* Output scaling ratio */
 	uint8_t msx, msy;			/* MCU size in unit of block (width, height) */
 	uint8_t qtid[3];			/* Quantization table ID of each component */
@@ -57,20 +80,28 @@ struct JDEC {
 	uint8_t* huffbits[2][2];	/* Huffman bit distribution tables [id][dcac] */
 	uint16_t* huffcode[2][2];	/* Huffman code word tables [id][dcac] */
 	uint8_t* huffdata[2][2];	/* Huffman decoded data tables [id][dcac] */
+#if JD_FASTDECODE
+	uint8_t* hufflut_dc[2];		/* Huffman lookup tables for short DC codes, code length << 4 | data [id] */
+	uint16_t* hufflut_ac[2];	/* Huffman lookup tables for short AC codes, code length << 8 | data [id] */
+#endif
 	int32_t* qttbl[4];			/* Dequantizer tables [id] */
 	void* workbuf;				/* Working buffer for IDCT and RGB output */
 	uint8_t* mcubuf;			/* Working buffer for the MCU */
 	void* pool;					/* Pointer to available memory pool */
 	unsigned int sz_pool;		/* Size of memory pool (bytes available) */
 	unsigned int (*infunc)(JDEC*, uint8_t*, unsigned int);	/* Pointer to jpeg stream input function */
+	unsigned int (*inref)(JDEC*, uint8_t**);	/* Optional input function pointing at the rest of a stream in memory, set after jd_prepare (JD_FASTDECODE only) */
 	void* device;				/* Pointer to I/O device identifier for the session */
-	uint16_t x_offs;			/* x offset for slow method */
-	uint16_t y_offs;			/* y offset for slow method */
+	JRECT crop;					/* Part of the image to output, all of it by default */
+#if JD_REFKERNEL
+	uint8_t refkernel;			/* Use the reference IDCT and color conversion (0:No, 1:Yes) */
+#endif
 };
 
 
 /* TJpgDec API functions */
-JRESULT jd_prepare (JDEC* jd, unsigned int (*infunc)(JDEC*,uint8_t*,unsigned int), void* pool, unsigned int sz_pool, void* dev);
+JRESULT jd_prepare (JDEC* jd, unsigned int (*infunc)(JDEC*,uint8_t*,unsigned int), void* pool, unsigned int sz_pool, unsigned int sz_buf, void* dev);
+JRESULT jd_next (JDEC* jd, void* dev);
 JRESULT jd_decomp (JDEC* jd, int (*outfunc)(JDEC*,void*,JRECT*), uint8_t scale);
 
 